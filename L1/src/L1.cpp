@@ -25,6 +25,7 @@ std::string Item::getL1Token() { return "<unknown-L1-token>"; }
 std::string Item::getX86Token() { return "<unknown-x86-token>"; }
 
 Register::Register(RegisterID id) : id{id} { return; }
+RegisterID Register::getID() { return id; }
 std::string Register::getL1Token() { return regToken[id]; }
 std::string Register::getX86Token() { return "%" + regToken[id]; }
 std::string Register::getX86Token8() { return "%" + regToken8[id]; }
@@ -86,6 +87,9 @@ std::string RetInst::getX86Inst() { return "retq"; }
 ShiftInst::ShiftInst(ShiftOp *op, Item *lval, Item *rval) : op{op}, lval{lval}, rval{rval} {
   return;
 }
+ShiftOp *ShiftInst::getOp() { return op; }
+Item *ShiftInst::getLval() { return lval; }
+Item *ShiftInst::getRval() { return rval; }
 std::string ShiftInst::getL1Inst() {
   return lval->getL1Token() + " " + op->getL1Token() + " " + rval->getL1Token();
 }
@@ -100,6 +104,9 @@ std::string ShiftInst::getX86Inst() {
 ArithInst::ArithInst(ArithOp *op, Item *lval, Item *rval) : op{op}, lval{lval}, rval{rval} {
   return;
 }
+ArithOp *ArithInst::getOp() { return op; }
+Item *ArithInst::getLval() { return lval; }
+Item *ArithInst::getRval() { return rval; }
 std::string ArithInst::getL1Inst() {
   return lval->getL1Token() + " " + op->getL1Token() + " " + rval->getL1Token();
 }
@@ -111,10 +118,14 @@ std::string ArithInst::getX86Inst() {
 }
 
 SelfModInst::SelfModInst(SelfModOp *op, Item *lval) : op{op}, lval{lval} { return; }
+SelfModOp *SelfModInst::getOp() { return op; }
+Item *SelfModInst::getLval() { return lval; }
 std::string SelfModInst::getL1Inst() { return lval->getL1Token() + " " + op->getL1Token(); }
 std::string SelfModInst::getX86Inst() { return op->getX86Token() + " " + lval->getX86Token(); }
 
 AssignInst::AssignInst(Item *lval, Item *rval) : lval{lval}, rval{rval} { return; }
+Item *AssignInst::getLval() { return lval; }
+Item *AssignInst::getRval() { return rval; }
 std::string AssignInst::getL1Inst() { return lval->getL1Token() + " <- " + rval->getL1Token(); }
 std::string AssignInst::getX86Inst() {
   auto r = rval->getX86Token();
@@ -129,6 +140,10 @@ CompareAssignInst::CompareAssignInst(Register *lval, CompareOp *op, Item *cmpLva
     : lval{lval}, op{op}, cmpLval{cmpLval}, cmpRval{cmpRval} {
   return;
 }
+Register *CompareAssignInst::getLval() { return lval; }
+CompareOp *CompareAssignInst::getOp() { return op; }
+Item *CompareAssignInst::getCmpLval() { return cmpLval; }
+Item *CompareAssignInst::getCmpRval() { return cmpRval; }
 std::string CompareAssignInst::getL1Inst() {
   return lval->getL1Token() + " <- " + cmpLval->getL1Token() + " " + op->getL1Token() + " " +
          cmpRval->getL1Token();
@@ -173,16 +188,32 @@ std::string CompareAssignInst::getX86Inst() {
   return cmpInst + setInst + movInst;
 }
 
+bool nativeCalls = false;
+
 CallInst::CallInst(Item *callee, Number *arg_num) : callee{callee}, arg_num{arg_num} { return; }
+Item *CallInst::getCallee() { return callee; }
+Number *CallInst::getArgNum() { return arg_num; }
 std::string CallInst::getL1Inst() {
   return "call " + callee->getL1Token() + " " + arg_num->getL1Token();
 }
 std::string CallInst::getX86Inst() {
+  auto argAmount = arg_num->getVal() > 6 ? 8 * (arg_num->getVal() - 6) : 0;
+  if (nativeCalls) {
+    // the return address is pushed right below the stack arguments
+    auto callInst = "call *" + callee->getX86Token();
+    if (dynamic_cast<FunctionName *>(callee)) {
+      callInst = "call " + callee->getX86Token();
+    }
+    if (argAmount == 0)
+      return callInst;
+    return "subq $" + std::to_string(argAmount) + ", %rsp\n  " + callInst;
+  }
+
   auto jmpInst = "jmp *" + callee->getX86Token();
   if (dynamic_cast<FunctionName *>(callee)) {
     jmpInst = "jmp " + callee->getX86Token();
   }
-  auto movAmount = (arg_num->getVal() > 6 ? 8 * (arg_num->getVal() - 6) : 0) + 8;
+  auto movAmount = argAmount + 8;
   auto movRspInst = "subq $" + std::to_string(movAmount) + ", %rsp\n  ";
   return movRspInst + jmpInst;
 }
@@ -200,6 +231,7 @@ std::string TupleErrorInst::getL1Inst() { return "call tuple-error 0"; }
 std::string TupleErrorInst::getX86Inst() { return "call tuple_error"; }
 
 TensorErrorInst::TensorErrorInst(Number *number) : number(number) { return; }
+Number *TensorErrorInst::getNumber() { return number; }
 std::string TensorErrorInst::getL1Inst() { return "call tensor-error " + number->getL1Token(); }
 std::string TensorErrorInst::getX86Inst() {
   switch (number->getVal()) {
@@ -218,6 +250,10 @@ SetInst::SetInst(Register *lval, Register *base, Register *offset, Number *scala
     : lval{lval}, base{base}, offset{offset}, scalar{scalar} {
   return;
 }
+Register *SetInst::getLval() { return lval; }
+Register *SetInst::getBase() { return base; }
+Register *SetInst::getOffset() { return offset; }
+Number *SetInst::getScalar() { return scalar; }
 std::string SetInst::getL1Inst() {
   return lval->getL1Token() + " @ " + base->getL1Token() + " " + offset->getL1Token() + " " +
          scalar->getL1Token();
@@ -228,10 +264,12 @@ std::string SetInst::getX86Inst() {
 }
 
 LabelInst::LabelInst(Label *label) : label{label} { return; }
+Label *LabelInst::getLabel() { return label; }
 std::string LabelInst::getL1Inst() { return label->getL1Token(); }
 std::string LabelInst::getX86Inst() { return label->getX86Token() + ":"; }
 
 GotoInst::GotoInst(Label *label) : label{label} { return; }
+Label *GotoInst::getLabel() { return label; }
 std::string GotoInst::getL1Inst() { return "goto " + label->getL1Token(); }
 std::string GotoInst::getX86Inst() { return "jmp " + label->getX86Token(); }
 
@@ -239,6 +277,10 @@ CondJumpInst::CondJumpInst(CompareOp *op, Item *lval, Item *rval, Label *label)
     : op{op}, lval{lval}, rval{rval}, label{label} {
   return;
 }
+CompareOp *CondJumpInst::getOp() { return op; }
+Item *CondJumpInst::getLval() { return lval; }
+Item *CondJumpInst::getRval() { return rval; }
+Label *CondJumpInst::getLabel() { return label; }
 std::string CondJumpInst::getL1Inst() {
   return "cjump " + lval->getL1Token() + " " + op->getL1Token() + " " + rval->getL1Token() + " " +
          label->getL1Token();
@@ -229,6 +229,13 @@ private:
   Number *arg_num;
 };
 
+/*
+ * Calls jump to the callee, which returns to the label stored by the caller at mem rsp -8, unless
+ * native calls are enabled: call and retq are then paired, and the callee pops its stack
+ * arguments when it returns.
+ */
+extern bool nativeCalls;
+
 class PrintInst : public Instruction {
 public:
   std::string getL1Inst() override;
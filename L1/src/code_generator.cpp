@@ -1,11 +1,24 @@
 #include "L1.h"
 #include <code_generator.h>
+#include <cstdlib>
+#include <elf_object.h>
 #include <fstream>
+#include <iostream>
+#include <peephole.h>
+#include <x86.h>
+#include <x86_encoder.h>
 
 using namespace std;
 
 namespace L1 {
-void generate_code(Program p) {
+vector<X86Inst> lower(Program &p, bool optimize) {
+  auto insts = lowerProgram(p);
+  if (optimize)
+    peepholeOptimize(insts);
+  return insts;
+}
+
+void generate_code(Program p, bool optimize) {
 
   /*
    * Open the output file.
@@ -13,6 +26,17 @@ void generate_code(Program p) {
   std::ofstream outputFile;
   outputFile.open("prog.S");
 
+  /*
+   * The optimized code is written from its structured form.
+   */
+  if (optimize) {
+    outputFile << ".text" << endl << "  .globl go" << endl;
+    for (auto &inst : lower(p, true))
+      outputFile << (inst.op == X86_LABEL ? "" : "  ") << inst.toStr() << endl;
+    outputFile.close();
+    return;
+  }
+
   /*
    * Generate target code
    */
@@ -41,15 +65,22 @@ void generate_code(Program p) {
 
     for (auto i : f->instructions) {
       auto indent = true;
-      if (i->getX86Inst() == "")
+      auto x86Inst = i->getX86Inst();
+      if (x86Inst == "")
         continue;
-      else if (i->getX86Inst() == "retq") {
-        int amount = (f->parameters > 6 ? (f->parameters - 6) * 8 : 0) + f->locals * 8;
+      else if (x86Inst == "retq") {
+        int argAmount = f->parameters > 6 ? (f->parameters - 6) * 8 : 0;
+        // with native calls the stack arguments are above the return address, retq pops them
+        int amount = nativeCalls ? f->locals * 8 : argAmount + f->locals * 8;
         if (amount > 0)
           outputFile << "  addq $" << amount << ", %rsp" << endl;
+        if (nativeCalls && argAmount > 0) {
+          outputFile << "  retq $" << argAmount << endl;
+          continue;
+        }
       } else if (dynamic_cast<LabelInst *>(i))
         indent = false;
-      outputFile << (indent ? "  " : "") << i->getX86Inst() << endl;
+      outputFile << (indent ? "  " : "") << x86Inst << endl;
     }
   }
   /*
@@ -59,4 +90,54 @@ void generate_code(Program p) {
 
   return;
 }
+
+void generate_object(Program p, bool optimize) {
+  auto code = encodeProgram(lower(p, optimize));
+  writeElfObject(code, "prog.o");
+}
+
+bool check_encoding(Program p, bool optimize) {
+  auto insts = lower(p, optimize);
+  auto code = encodeProgram(insts);
+
+  /*
+   * Assemble prog.S.
+   */
+  generate_code(p, optimize);
+  if (system("as --64 -o prog.check.o prog.S") != 0) {
+    cerr << "prog.S could not be assembled" << endl;
+    return false;
+  }
+  auto expected = readElfText("prog.check.o");
+
+  /*
+   * Compare the code, instruction by instruction.
+   */
+  for (size_t i = 0; i < insts.size(); i++) {
+    auto first = code.offsets[i];
+    auto last = i + 1 < insts.size() ? code.offsets[i + 1] : (int64_t)code.text.size();
+    string encoded, assembled;
+    auto hex = [](uint8_t byte) {
+      const char digits[] = "0123456789abcdef";
+      return string{digits[byte >> 4], digits[byte & 15], ' '};
+    };
+    for (auto k = first; k < last; k++) {
+      encoded += hex(code.text[k]);
+      assembled += k < (int64_t)expected.size() ? hex(expected[k]) : "-- ";
+    }
+    if (encoded != assembled) {
+      cerr << "encoding mismatch at offset " << first << ", " << insts[i].toStr() << endl
+           << "  encoded:   " << encoded << endl
+           << "  assembled: " << assembled << endl;
+      return false;
+    }
+  }
+  if (code.text.size() != expected.size()) {
+    cerr << "encoding mismatch, " << code.text.size() << " bytes encoded, " << expected.size()
+         << " assembled" << endl;
+    return false;
+  }
+  cerr << "encoding matches prog.S, " << code.text.size() << " bytes" << endl;
+  return true;
+}
 } // namespace L1
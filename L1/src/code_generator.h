@@ -4,6 +4,20 @@
 
 namespace L1{
 
-  void generate_code(Program p);
+  /*
+   * Write prog.S. When optimizing, the peephole optimizer rewrites the generated instructions.
+   */
+  void generate_code(Program p, bool optimize);
+
+  /*
+   * Write prog.o, encoding the program directly instead of assembling prog.S.
+   */
+  void generate_object(Program p, bool optimize);
+
+  /*
+   * Assemble prog.S with as and compare its code to the directly encoded one, the first
+   * instruction whose bytes differ is reported. Returns whether they are identical.
+   */
+  bool check_encoding(Program p, bool optimize);
 
 }
@@ -5,17 +5,22 @@
 #include <unistd.h>
 
 #include <code_generator.h>
+#include <jit.h>
 #include <parser.h>
 
 void print_help(char *progName) {
-  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] SOURCE" << std::endl;
+  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-n] [-e] [-x] [-r] SOURCE"
+            << std::endl;
   return;
 }
 
 int main(int argc, char **argv) {
   auto enable_code_generator = false;
+  auto object_output = false;
+  auto check_encoder = false;
+  auto run = false;
   int32_t optLevel = 0;
-  bool verbose;
+  bool verbose = false;
 
   /*
    * Check the compiler arguments.
@@ -25,12 +30,28 @@ int main(int argc, char **argv) {
     return 1;
   }
   int32_t opt;
-  while ((opt = getopt(argc, argv, "vdg:O:")) != -1) {
+  while ((opt = getopt(argc, argv, "vdg:O:nexr")) != -1) {
     switch (opt) {
     case 'O':
       optLevel = strtoul(optarg, NULL, 0);
       break;
 
+    case 'n':
+      L1::nativeCalls = true;
+      break;
+
+    case 'e':
+      object_output = true;
+      break;
+
+    case 'x':
+      check_encoder = true;
+      break;
+
+    case 'r':
+      run = true;
+      break;
+
     case 'g':
       enable_code_generator = (strtoul(optarg, NULL, 0) == 0) ? false : true;
       break;
@@ -55,7 +76,7 @@ int main(int argc, char **argv) {
   auto p = L1::parse_file(argv[optind]);
 
   /*
-   * Code optimizations (optional)
+   * Code optimizations (optional): the peephole optimizer runs on the generated code from -O1.
    */
 
   /*
@@ -74,10 +95,29 @@ int main(int argc, char **argv) {
   }
 
   /*
-   * Generate x86_64 assembly.
+   * Check the encoder against the assembler.
+   */
+  if (check_encoder) {
+    return L1::check_encoding(p, optLevel > 0) ? 0 : 1;
+  }
+
+  /*
+   * Run the program in process instead of generating code.
+   */
+  if (run) {
+    L1::run_jit(p, optLevel > 0);
+    return 0;
+  }
+
+  /*
+   * Generate x86_64 assembly, or an object file.
    */
   if (enable_code_generator) {
-    L1::generate_code(p);
+    if (object_output) {
+      L1::generate_object(p, optLevel > 0);
+    } else {
+      L1::generate_code(p, optLevel > 0);
+    }
   }
 
   return 0;
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <elf_object.h>
+#include <x86_encoder.h>
+
+namespace L1 {
+
+/*
+ * String table, names are appended once.
+ */
+class StringTable {
+public:
+  StringTable() : data{'\0'} { return; }
+
+  uint32_t add(std::string name) {
+    if (indices.count(name))
+      return indices.at(name);
+    auto index = (uint32_t)data.size();
+    data.insert(data.end(), name.begin(), name.end());
+    data.push_back('\0');
+    indices[name] = index;
+    return index;
+  }
+
+  std::vector<char> data;
+
+private:
+  std::unordered_map<std::string, uint32_t> indices;
+};
+
+template <typename T> void append(std::vector<char> &out, const T &value) {
+  auto bytes = (const char *)&value;
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void align(std::vector<char> &out, size_t alignment) {
+  while (out.size() % alignment != 0)
+    out.push_back('\0');
+}
+
+void writeElfObject(const MachineCode &code, std::string fileName) {
+  enum { NULL_SECTION, TEXT, RELA_TEXT, NOTE_STACK, SYMTAB, STRTAB, SHSTRTAB, SECTION_NUM };
+  StringTable strtab, shstrtab;
+
+  /*
+   * Symbols: the local labels, then go and the runtime functions. The relocations against local
+   * labels are made against the section, as the assembler does.
+   */
+  std::vector<Elf64_Sym> symbols(2);
+  memset(symbols.data(), 0, sizeof(Elf64_Sym) * symbols.size());
+  symbols[1].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+  symbols[1].st_shndx = TEXT;
+
+  std::vector<std::pair<int64_t, std::string>> labels;
+  for (auto &[name, offset] : code.labels)
+    if (name != "go")
+      labels.push_back({offset, name});
+  std::sort(labels.begin(), labels.end());
+  auto addSymbol = [&](std::string name, unsigned char bind, uint16_t section, int64_t value) {
+    Elf64_Sym symbol;
+    memset(&symbol, 0, sizeof(symbol));
+    symbol.st_name = strtab.add(name);
+    symbol.st_info = ELF64_ST_INFO(bind, STT_NOTYPE);
+    symbol.st_shndx = section;
+    symbol.st_value = value;
+    symbols.push_back(symbol);
+    return (uint32_t)(symbols.size() - 1);
+  };
+  for (auto &[offset, name] : labels)
+    addSymbol(name, STB_LOCAL, TEXT, offset);
+  auto firstGlobal = (uint32_t)symbols.size();
+  if (code.labels.count("go"))
+    addSymbol("go", STB_GLOBAL, TEXT, code.labels.at("go"));
+
+  std::unordered_map<std::string, uint32_t> externals;
+  std::vector<Elf64_Rela> relocations;
+  for (auto &relocation : code.relocations) {
+    Elf64_Rela rela;
+    rela.r_offset = relocation.offset;
+    rela.r_addend = relocation.addend;
+    uint32_t symbol = 1;
+    if (code.labels.count(relocation.symbol))
+      rela.r_addend += code.labels.at(relocation.symbol);
+    else {
+      if (!externals.count(relocation.symbol))
+        externals[relocation.symbol] = addSymbol(relocation.symbol, STB_GLOBAL, SHN_UNDEF, 0);
+      symbol = externals.at(relocation.symbol);
+    }
+    rela.r_info = ELF64_R_INFO(symbol, relocation.type);
+    relocations.push_back(rela);
+  }
+
+  /*
+   * Layout: the header, the content of the sections, the section headers.
+   */
+  std::vector<char> out(sizeof(Elf64_Ehdr), '\0');
+  std::vector<Elf64_Shdr> sections(SECTION_NUM);
+  memset(sections.data(), 0, sizeof(Elf64_Shdr) * sections.size());
+  auto addSection = [&](int index, std::string name, uint32_t type, uint64_t flags,
+                        size_t alignment, const char *data, size_t size) {
+    align(out, alignment);
+    auto &section = sections[index];
+    section.sh_name = shstrtab.add(name);
+    section.sh_type = type;
+    section.sh_flags = flags;
+    section.sh_offset = out.size();
+    section.sh_size = size;
+    section.sh_addralign = alignment;
+    out.insert(out.end(), data, data + size);
+  };
+
+  addSection(TEXT, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16,
+             (const char *)code.text.data(), code.text.size());
+  addSection(RELA_TEXT, ".rela.text", SHT_RELA, SHF_INFO_LINK, 8,
+             (const char *)relocations.data(), relocations.size() * sizeof(Elf64_Rela));
+  sections[RELA_TEXT].sh_link = SYMTAB;
+  sections[RELA_TEXT].sh_info = TEXT;
+  sections[RELA_TEXT].sh_entsize = sizeof(Elf64_Rela);
+  // the stack is not executable
+  addSection(NOTE_STACK, ".note.GNU-stack", SHT_PROGBITS, 0, 1, nullptr, 0);
+  addSection(SYMTAB, ".symtab", SHT_SYMTAB, 0, 8, (const char *)symbols.data(),
+             symbols.size() * sizeof(Elf64_Sym));
+  sections[SYMTAB].sh_link = STRTAB;
+  sections[SYMTAB].sh_info = firstGlobal;
+  sections[SYMTAB].sh_entsize = sizeof(Elf64_Sym);
+  addSection(STRTAB, ".strtab", SHT_STRTAB, 0, 1, strtab.data.data(), strtab.data.size());
+  // the name of .shstrtab is added before its content is copied
+  shstrtab.add(".shstrtab");
+  addSection(SHSTRTAB, ".shstrtab", SHT_STRTAB, 0, 1, shstrtab.data.data(), shstrtab.data.size());
+
+  align(out, 8);
+  auto sectionOffset = out.size();
+  for (auto &section : sections)
+    append(out, section);
+
+  Elf64_Ehdr header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = ET_REL;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_shoff = sectionOffset;
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = SECTION_NUM;
+  header.e_shstrndx = SHSTRTAB;
+  memcpy(out.data(), &header, sizeof(header));
+
+  std::ofstream outputFile(fileName, std::ios::binary);
+  outputFile.write(out.data(), out.size());
+  if (!outputFile)
+    throw std::runtime_error("cannot write " + fileName);
+}
+
+std::vector<uint8_t> readElfText(std::string fileName) {
+  std::ifstream inputFile(fileName, std::ios::binary);
+  std::vector<char> in((std::istreambuf_iterator<char>(inputFile)),
+                       std::istreambuf_iterator<char>());
+  if (in.size() < sizeof(Elf64_Ehdr) || memcmp(in.data(), ELFMAG, SELFMAG) != 0)
+    throw std::runtime_error(fileName + " is not an ELF object");
+
+  auto header = (const Elf64_Ehdr *)in.data();
+  auto sections = (const Elf64_Shdr *)(in.data() + header->e_shoff);
+  auto names = in.data() + sections[header->e_shstrndx].sh_offset;
+  for (int i = 0; i < header->e_shnum; i++)
+    if (strcmp(names + sections[i].sh_name, ".text") == 0) {
+      auto first = in.data() + sections[i].sh_offset;
+      return std::vector<uint8_t>(first, first + sections[i].sh_size);
+    }
+  throw std::runtime_error(fileName + " has no .text section");
+}
+
+} // namespace L1
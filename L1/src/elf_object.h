@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <x86_encoder.h>
+
+namespace L1 {
+
+/*
+ * Write the machine code of a program as a relocatable ELF x86-64 object, with go as its only
+ * global symbol. The calls to the runtime are left undefined, to be linked as for prog.S.
+ */
+void writeElfObject(const MachineCode &code, std::string fileName);
+
+/*
+ * The content of the .text section of an ELF object.
+ */
+std::vector<uint8_t> readElfText(std::string fileName);
+
+} // namespace L1
@@ -1,29 +1,53 @@
+#include <cstdlib>
 #include <iostream>
 #include <stdint.h>
 #include <unistd.h>
 
 #include <code_generator.h>
 #include <parser.h>
+#include <threaded_interpreter.h>
 
 using namespace std;
 
 void print_help(char *progName) {
-  std::cerr << "Usage: " << progName << " SOURCE" << std::endl;
+  std::cerr << "Usage: " << progName << " [-n] [-c] SOURCE" << std::endl;
   return;
 }
 
 int main(int argc, char **argv) {
-  auto enable_code_generator = false;
-  int32_t optLevel = 0;
-  bool verbose;
+  auto count_instructions = false;
 
   /*
-   * Check the compiler arguments.
+   * Check the interpreter arguments.
    */
   if (argc < 2) {
     print_help(argv[0]);
     return 1;
   }
+  int32_t opt;
+  while ((opt = getopt(argc, argv, "ncd")) != -1) {
+    switch (opt) {
+    case 'n':
+      L1::nativeCalls = true;
+      break;
+
+    case 'c':
+      count_instructions = true;
+      break;
+
+    case 'd':
+      debugEnabled = true;
+      break;
+
+    default:
+      print_help(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc) {
+    print_help(argv[0]);
+    return 1;
+  }
 
   /*
    * Parse the input file.
@@ -33,7 +57,19 @@ int main(int argc, char **argv) {
   /*
    * Interpret the L1 program.
    */
-  // TODO
+  auto counts = L1::interpret(p, count_instructions);
+
+  /*
+   * Report the executed instructions, apart from the output of the program.
+   */
+  if (count_instructions) {
+    int64_t total = 0;
+    for (size_t i = 0; i < p.functions.size(); i++) {
+      cerr << p.functions[i]->name << " " << counts[i] << endl;
+      total += counts[i];
+    }
+    cerr << "total " << total << endl;
+  }
 
   return 0;
 }
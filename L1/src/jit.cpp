@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <elf.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unordered_map>
+#include <vector>
+
+#include <helper.h>
+#include <jit.h>
+#include <peephole.h>
+#include <runtime.h>
+#include <x86.h>
+#include <x86_encoder.h>
+
+namespace L1 {
+
+// the runtime functions the code can call
+const std::unordered_map<std::string, void *> runtimeFunctions = {
+    {"print", (void *)runtimePrint},
+    {"input", (void *)runtimeInput},
+    {"allocate", (void *)runtimeAllocate},
+    {"tuple_error", (void *)runtimeTupleError},
+    {"array_tensor_error_null", (void *)runtimeArrayTensorErrorNull},
+    {"array_error", (void *)runtimeArrayError},
+    {"tensor_error", (void *)runtimeTensorError},
+};
+
+/*
+ * The L1 frames keep no alignment, a call to the runtime goes through a stub that aligns the stack
+ * before calling the function at the absolute address following it:
+ *   pushq %rbp; movq %rsp, %rbp; andq $-16, %rsp; call *5(%rip); movq %rbp, %rsp; popq %rbp; retq
+ */
+const std::vector<uint8_t> stubCode = {0x55, 0x48, 0x89, 0xe5, 0x48, 0x83, 0xe4, 0xf0, 0xff, 0x15,
+                                       0x05, 0x00, 0x00, 0x00, 0x48, 0x89, 0xec, 0x5d, 0xc3};
+
+void patch(uint8_t *field, int64_t value) {
+  if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max())
+    throw std::runtime_error("relocated value out of range");
+  auto value32 = (int32_t)value;
+  memcpy(field, &value32, sizeof(value32));
+}
+
+void run_jit(Program p, bool optimize) {
+  auto insts = lowerProgram(p);
+  if (optimize)
+    peepholeOptimize(insts);
+  auto code = encodeProgram(insts);
+  if (!code.labels.count("go"))
+    throw std::runtime_error("no entry point");
+
+  /*
+   * Lay out the code, then one stub per runtime function it calls.
+   */
+  std::vector<uint8_t> image = code.text;
+  std::unordered_map<std::string, int64_t> stubs;
+  for (auto &relocation : code.relocations) {
+    if (code.labels.count(relocation.symbol) || stubs.count(relocation.symbol))
+      continue;
+    if (!runtimeFunctions.count(relocation.symbol))
+      throw std::runtime_error("unknown runtime function " + relocation.symbol);
+    while (image.size() % 16 != 0)
+      image.push_back(0xcc);
+    stubs[relocation.symbol] = image.size();
+    image.insert(image.end(), stubCode.begin(), stubCode.end());
+    auto address = (uint64_t)runtimeFunctions.at(relocation.symbol);
+    for (int i = 0; i < 8; i++)
+      image.push_back((address >> (8 * i)) & 0xff);
+  }
+
+  /*
+   * The labels used as immediates are 32 bit sign extended absolute addresses, so the code is
+   * mapped in the first 2GB.
+   */
+  auto size = image.size();
+  auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT,
+                     -1, 0);
+  if (memory == MAP_FAILED)
+    throw std::runtime_error("cannot map memory for the code");
+  auto base = (uint8_t *)memory;
+  memcpy(base, image.data(), size);
+
+  for (auto &relocation : code.relocations) {
+    auto field = base + relocation.offset;
+    if (relocation.type == R_X86_64_PLT32) {
+      auto target = code.labels.count(relocation.symbol) ? code.labels.at(relocation.symbol)
+                                                         : stubs.at(relocation.symbol);
+      patch(field, target + relocation.addend - relocation.offset);
+    } else if (relocation.type == R_X86_64_32S) {
+      patch(field, (int64_t)base + code.labels.at(relocation.symbol) + relocation.addend);
+    } else {
+      throw std::runtime_error("unsupported relocation type " + std::to_string(relocation.type));
+    }
+  }
+
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+    throw std::runtime_error("cannot make the code executable");
+  debug("running " + std::to_string(code.text.size()) + " bytes of code");
+
+  auto go = (void (*)())(base + code.labels.at("go"));
+  go();
+  fflush(stdout);
+  munmap(memory, size);
+}
+
+} // namespace L1
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <L1.h>
+
+namespace L1 {
+
+/*
+ * Encode a program into executable memory and run it in process, from go. The calls to print,
+ * input, allocate and the error functions are bound to the runtime built in the compiler; an
+ * error terminates the process. The code is optimized as for generate_code.
+ */
+void run_jit(Program p, bool optimize);
+
+} // namespace L1
@@ -0,0 +1,178 @@
+#include <cstdint>
+#include <vector>
+
+#include <peephole.h>
+#include <x86.h>
+
+namespace L1 {
+
+/*
+ * A rewrite of a window of size instructions. apply fills the replacement and returns whether the
+ * window matches.
+ */
+class PeepholeRule {
+public:
+  size_t size;
+  bool (*apply)(const X86Inst *window, std::vector<X86Inst> &replacement);
+};
+
+bool isImm(const X86Operand &operand, int64_t value) {
+  return operand.kind == X86Operand::IMM && operand.value == value;
+}
+
+bool isReg(const X86Operand &operand) { return operand.kind == X86Operand::REG; }
+
+// cmp and test are followed by the instruction using their flags, which the rewrites keep
+bool readsFlags(const X86Inst &inst) { return inst.op == X86_SET || inst.op == X86_JCC; }
+
+X86Cond negate(X86Cond cond) { return (X86Cond)(cond ^ 1); }
+
+// the condition for the flags set by comparing lhs to rhs
+bool evaluate(X86Cond cond, int64_t lhs, int64_t rhs) {
+  switch (cond) {
+  case X86_E:
+    return lhs == rhs;
+  case X86_NE:
+    return lhs != rhs;
+  case X86_L:
+    return lhs < rhs;
+  case X86_GE:
+    return lhs >= rhs;
+  case X86_LE:
+    return lhs <= rhs;
+  default:
+    return lhs > rhs;
+  }
+}
+
+// movq $0, %r -> xorq %r, %r, which clobbers the flags
+bool clearWithXor(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &mov = window[0];
+  if (mov.op != X86_MOV || !isImm(mov.operands[0], 0) || !isReg(mov.operands[1]) ||
+      readsFlags(window[1]))
+    return false;
+  replacement = {{X86_XOR, {mov.operands[1], mov.operands[1]}}, window[1]};
+  return true;
+}
+
+// cmpq $0, %r -> testq %r, %r
+bool testForZero(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &cmp = window[0];
+  if (cmp.op != X86_CMP || !isImm(cmp.operands[0], 0) || !isReg(cmp.operands[1]))
+    return false;
+  replacement = {{X86_TEST, {cmp.operands[1], cmp.operands[1]}}};
+  return true;
+}
+
+// addq $1, %r -> inc %r, subq $1, %r -> dec %r
+bool incrementByOne(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &inst = window[0];
+  if ((inst.op != X86_ADD && inst.op != X86_SUB) || !isReg(inst.operands[1]))
+    return false;
+  auto &src = inst.operands[0];
+  if (isImm(src, 1))
+    replacement = {{inst.op == X86_ADD ? X86_INC : X86_DEC, {inst.operands[1]}}};
+  else if (isImm(src, -1))
+    replacement = {{inst.op == X86_ADD ? X86_DEC : X86_INC, {inst.operands[1]}}};
+  else
+    return false;
+  return true;
+}
+
+// imulq $2^k, %r -> salq $k, %r
+bool shiftForMultiply(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &imul = window[0];
+  if (imul.op != X86_IMUL || imul.operands[0].kind != X86Operand::IMM || !isReg(imul.operands[1]))
+    return false;
+  auto value = imul.operands[0].value;
+  if (value < 2 || (value & (value - 1)) != 0)
+    return false;
+  int64_t shift = 0;
+  while (((int64_t)1 << shift) != value)
+    shift++;
+  replacement = {{X86_SAL, {X86Operand::imm(shift), imul.operands[1]}}};
+  return true;
+}
+
+/*
+ * setcc %r; movzbq %r, %r; cmpq $k, %r; jcc label: %r is 0 or 1, so the jump depends only on the
+ * flags the setcc read, which movzbq keeps. The jump is taken on them, always or never.
+ */
+bool fuseCompareJump(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &set = window[0], &movzb = window[1], &cmp = window[2], &jcc = window[3];
+  if (set.op != X86_SET || movzb.op != X86_MOVZB || jcc.op != X86_JCC)
+    return false;
+  auto &reg = set.operands[0];
+  if (movzb.operands[0] != reg || movzb.operands[1] != reg)
+    return false;
+  int64_t rhs;
+  if (cmp.op == X86_CMP && cmp.operands[0].kind == X86Operand::IMM && cmp.operands[1] == reg)
+    rhs = cmp.operands[0].value;
+  else if (cmp.op == X86_TEST && cmp.operands[0] == reg && cmp.operands[1] == reg)
+    rhs = 0;
+  else
+    return false;
+
+  auto whenSet = evaluate(jcc.cond, 1, rhs);
+  auto whenClear = evaluate(jcc.cond, 0, rhs);
+  replacement = {set, movzb};
+  if (whenSet && whenClear)
+    replacement.push_back({X86_JMP, jcc.operands});
+  else if (whenSet)
+    replacement.push_back({X86_JCC, set.cond, jcc.operands});
+  else if (whenClear)
+    replacement.push_back({X86_JCC, negate(set.cond), jcc.operands});
+  return true;
+}
+
+// jmp label; label: -> label:
+bool jumpToNext(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &jmp = window[0], &label = window[1];
+  if (jmp.op != X86_JMP || label.op != X86_LABEL || jmp.operands[0] != label.operands[0])
+    return false;
+  replacement = {label};
+  return true;
+}
+
+// jcc next; jmp label; next: -> jncc label; next:
+bool invertBranch(const X86Inst *window, std::vector<X86Inst> &replacement) {
+  auto &jcc = window[0], &jmp = window[1], &next = window[2];
+  if (jcc.op != X86_JCC || jmp.op != X86_JMP || jmp.operands[0].kind != X86Operand::SYM ||
+      next.op != X86_LABEL || jcc.operands[0] != next.operands[0])
+    return false;
+  replacement = {{X86_JCC, negate(jcc.cond), jmp.operands}, next};
+  return true;
+}
+
+const PeepholeRule rules[] = {
+    {2, clearWithXor},    {1, testForZero}, {1, incrementByOne}, {1, shiftForMultiply},
+    {4, fuseCompareJump}, {2, jumpToNext},  {3, invertBranch},
+};
+
+void peepholeOptimize(std::vector<X86Inst> &insts) {
+  /*
+   * The instructions are moved one at a time to the output, and the rules are applied to the
+   * windows ending with it until none matches, so that a rewrite can enable another one.
+   */
+  std::vector<X86Inst> out;
+  out.reserve(insts.size());
+  std::vector<X86Inst> replacement;
+  for (auto &inst : insts) {
+    out.push_back(inst);
+    auto changed = true;
+    while (changed) {
+      changed = false;
+      for (auto &rule : rules) {
+        if (out.size() < rule.size || !rule.apply(&out[out.size() - rule.size], replacement))
+          continue;
+        out.erase(out.end() - rule.size, out.end());
+        out.insert(out.end(), replacement.begin(), replacement.end());
+        changed = true;
+        break;
+      }
+    }
+  }
+  insts.swap(out);
+}
+
+} // namespace L1
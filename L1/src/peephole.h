@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+#include <x86.h>
+
+namespace L1 {
+
+/*
+ * Rewrite short windows of the generated instructions into cheaper equivalent ones: xor to clear a
+ * register, test against zero, inc/dec, shifts for multiplications by powers of two, conditional
+ * jumps on the flags of the comparison a setcc just saved, no jump to the next instruction and
+ * no unconditional jump over which a conditional one branches.
+ */
+void peepholeOptimize(std::vector<X86Inst> &insts);
+
+} // namespace L1
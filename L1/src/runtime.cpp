@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <runtime.h>
+
+namespace L1 {
+
+[[noreturn]] void runtimeError(std::string message) {
+  fflush(stdout);
+  fprintf(stderr, "%s\n", message.c_str());
+  exit(-1);
+}
+
+void printValue(int64_t value) {
+  if (value & 1) {
+    printf("%ld", value >> 1);
+    return;
+  }
+  if (value == 0) {
+    printf("0");
+    return;
+  }
+  auto array = (int64_t *)value;
+  auto length = array[0];
+  printf("{s:%ld", length);
+  for (int64_t i = 1; i <= length; i++) {
+    printf(", ");
+    printValue(array[i]);
+  }
+  printf("}");
+}
+
+void runtimePrint(int64_t value) {
+  printValue(value);
+  printf("\n");
+}
+
+int64_t runtimeInput() {
+  long value;
+  if (scanf("%ld", &value) != 1)
+    return 1;
+  return ((int64_t)value << 1) | 1;
+}
+
+int64_t runtimeAllocate(int64_t length, int64_t value) {
+  if (!(length & 1) || length < 0)
+    runtimeError("allocate called with an invalid length");
+  auto words = (length >> 1) + 1;
+  auto array = (int64_t *)malloc(words * sizeof(int64_t));
+  if (array == nullptr)
+    runtimeError("out of memory");
+  array[0] = length >> 1;
+  for (int64_t i = 1; i < words; i++)
+    array[i] = value;
+  return (int64_t)array;
+}
+
+void runtimeTupleError(int64_t line, int64_t length, int64_t index) {
+  runtimeError("attempted to use position " + std::to_string(index >> 1) + " of an array of size " +
+               std::to_string(length >> 1) + " (line " + std::to_string(line >> 1) + ")");
+}
+
+void runtimeArrayTensorErrorNull(int64_t line) {
+  runtimeError("attempted to use a zero-dimensional array (line " + std::to_string(line >> 1) +
+               ")");
+}
+
+void runtimeArrayError(int64_t line, int64_t length, int64_t index) {
+  runtimeError("attempted to access index " + std::to_string(index >> 1) + " of an array of size " +
+               std::to_string(length >> 1) + " (line " + std::to_string(line >> 1) + ")");
+}
+
+void runtimeTensorError(int64_t line, int64_t dimension, int64_t length, int64_t index) {
+  runtimeError("attempted to access index " + std::to_string(index >> 1) + " of dimension " +
+               std::to_string(dimension >> 1) + " of a tensor of size " +
+               std::to_string(length >> 1) + " (line " + std::to_string(line >> 1) + ")");
+}
+
+} // namespace L1
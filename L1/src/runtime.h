@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace L1 {
+
+/*
+ * Runtime of the programs run in process. The numbers are encoded as 2n+1, an array is a pointer
+ * to its number of elements, which is not encoded, followed by its elements. The errors print a
+ * message and terminate the process.
+ */
+[[noreturn]] void runtimeError(std::string message);
+void runtimePrint(int64_t value);
+int64_t runtimeInput();
+int64_t runtimeAllocate(int64_t length, int64_t value);
+void runtimeTupleError(int64_t line, int64_t length, int64_t index);
+void runtimeArrayTensorErrorNull(int64_t line);
+void runtimeArrayError(int64_t line, int64_t length, int64_t index);
+void runtimeTensorError(int64_t line, int64_t dimension, int64_t length, int64_t index);
+
+} // namespace L1
@@ -0,0 +1,475 @@
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <L1.h>
+#include <helper.h>
+#include <runtime.h>
+#include <threaded_interpreter.h>
+
+namespace L1 {
+
+/*
+ * Operations of the decoded instructions. An R operand is a pointer to a register or to an
+ * immediate of the instruction, an M operand is the memory location at offset from base.
+ */
+#define DECODED_OPS(X)                                                                             \
+  X(MOV_RR) X(MOV_RM) X(MOV_MR)                                                                    \
+  X(ADD_RR) X(ADD_RM) X(ADD_MR)                                                                    \
+  X(SUB_RR) X(SUB_RM) X(SUB_MR)                                                                    \
+  X(MUL_RR) X(MUL_RM) X(MUL_MR)                                                                    \
+  X(AND_RR) X(AND_RM) X(AND_MR)                                                                    \
+  X(SAL) X(SAR) X(INC) X(DEC)                                                                      \
+  X(LT) X(LE) X(EQ) X(JLT) X(JLE) X(JEQ) X(JMP)                                                    \
+  X(LEA) X(ENTER) X(CALL) X(CALL_INDIRECT) X(CALL_NATIVE) X(CALL_NATIVE_INDIRECT) X(RET)           \
+  X(PRINT) X(INPUT) X(ALLOCATE) X(TUPLE_ERROR)                                                     \
+  X(ARRAY_TENSOR_ERROR_NULL) X(ARRAY_ERROR) X(TENSOR_ERROR) X(HALT)
+
+#define DECODED_OP_ENUM(name) OP_##name,
+enum DecodedOp { DECODED_OPS(DECODED_OP_ENUM) };
+#undef DECODED_OP_ENUM
+
+class DecodedInst {
+public:
+  DecodedOp op;
+  // address of the handler of op, set when the program is executed
+  void *handler;
+  // the destination, or the first operand of a comparison
+  int64_t *dst;
+  // the source, or the second operand of a comparison or the index of lea
+  int64_t *src;
+  int64_t *src2;
+  // base register and offset of the M operand, the scale of lea
+  int64_t *base;
+  int64_t offset;
+  // the stack space allocated by enter or call and freed by ret, and the arguments popped by ret
+  int64_t amount;
+  int64_t popped;
+  DecodedInst *target;
+  int64_t immediates[2];
+  // index of the function in the program, -1 for the instructions which are not in the source
+  int64_t function;
+};
+
+/*
+ * Decoder of the program into a flat array. The array is allocated once, so that the pointers to
+ * the immediates and the addresses of the labels stay valid.
+ */
+class Decoder {
+public:
+  Decoder(Program &p, int64_t *registers) : registers{registers} {
+    size_t size = 1;
+    for (auto f : p.functions)
+      size += f->instructions.size() + 1;
+    code.reserve(size);
+
+    for (int64_t i = 0; i < (int64_t)p.functions.size(); i++)
+      decodeFunction(p.functions[i], i);
+    // the return address of the entry point
+    add(OP_HALT, -1);
+
+    for (auto &[field, name] : labelFixups)
+      *field = resolve(name);
+    for (auto &[field, name] : valueFixups)
+      *field = (int64_t)resolve(name);
+    entry = resolve(p.entryPointLabel);
+  }
+
+  std::vector<DecodedInst> code;
+  DecodedInst *entry;
+
+private:
+  // the instruction a label or a function name stands for
+  DecodedInst *resolve(std::string name) {
+    auto &addresses = name[0] == '@' ? functions : labels;
+    if (!addresses.count(name))
+      throw std::runtime_error("unknown label " + name);
+    return &code[addresses.at(name)];
+  }
+
+  DecodedInst &add(DecodedOp op, int64_t function) {
+    code.push_back({});
+    auto &inst = code.back();
+    inst.op = op;
+    inst.function = function;
+    return inst;
+  }
+
+  /*
+   * The R operand of a register, a number or the address of a label or a function, which is
+   * stored as an immediate of the instruction.
+   */
+  int64_t *value(DecodedInst &inst, Item *item, int slot) {
+    if (auto reg = dynamic_cast<Register *>(item))
+      return &registers[reg->getID()];
+    auto immediate = &inst.immediates[slot];
+    if (auto num = dynamic_cast<Number *>(item))
+      *immediate = num->getVal();
+    else if (dynamic_cast<Label *>(item) || dynamic_cast<FunctionName *>(item))
+      valueFixups.push_back({immediate, item->getL1Token()});
+    else
+      throw std::runtime_error("unexpected operand " + item->getL1Token());
+    return immediate;
+  }
+
+  int64_t *reg(Item *item) {
+    auto reg = dynamic_cast<Register *>(item);
+    if (!reg)
+      throw std::runtime_error("unexpected operand " + item->getL1Token());
+    return &registers[reg->getID()];
+  }
+
+  /*
+   * Add an instruction with a destination and a source, one of which can be a memory location.
+   * ops holds the RR, RM and MR forms of the operation.
+   */
+  void addBinary(const DecodedOp ops[], Item *lval, Item *rval, int64_t function) {
+    auto &inst = add(ops[0], function);
+    if (auto mem = dynamic_cast<MemoryLocation *>(lval)) {
+      inst.op = ops[2];
+      inst.base = &registers[mem->getReg()->getID()];
+      inst.offset = mem->getOffset()->getVal();
+      inst.src = value(inst, rval, 0);
+    } else if (auto mem = dynamic_cast<MemoryLocation *>(rval)) {
+      inst.op = ops[1];
+      inst.dst = reg(lval);
+      inst.base = &registers[mem->getReg()->getID()];
+      inst.offset = mem->getOffset()->getVal();
+    } else {
+      inst.dst = reg(lval);
+      inst.src = value(inst, rval, 0);
+    }
+  }
+
+  void decodeFunction(Function *f, int64_t function) {
+    functions[f->name] = code.size();
+    if (f->locals > 0) {
+      auto &enter = add(OP_ENTER, -1);
+      enter.amount = f->locals * 8;
+    }
+    for (auto I : f->instructions)
+      decodeInstruction(f, I, function);
+  }
+
+  void decodeInstruction(Function *f, Instruction *I, int64_t function) {
+    const DecodedOp compareOps[] = {OP_LT, OP_LE, OP_EQ};
+    const DecodedOp jumpOps[] = {OP_JLT, OP_JLE, OP_JEQ};
+
+    if (dynamic_cast<RetInst *>(I)) {
+      auto &inst = add(OP_RET, function);
+      int64_t argAmount = f->parameters > 6 ? (f->parameters - 6) * 8 : 0;
+      inst.amount = nativeCalls ? f->locals * 8 : argAmount + f->locals * 8;
+      inst.popped = nativeCalls ? argAmount : 0;
+
+    } else if (auto shiftInst = dynamic_cast<ShiftInst *>(I)) {
+      auto op = shiftInst->getOp()->getID() == ShiftOpID::LEFT ? OP_SAL : OP_SAR;
+      auto &inst = add(op, function);
+      inst.dst = reg(shiftInst->getLval());
+      inst.src = value(inst, shiftInst->getRval(), 0);
+
+    } else if (auto arithInst = dynamic_cast<ArithInst *>(I)) {
+      const DecodedOp ops[][3] = {{OP_ADD_RR, OP_ADD_RM, OP_ADD_MR},
+                                  {OP_SUB_RR, OP_SUB_RM, OP_SUB_MR},
+                                  {OP_MUL_RR, OP_MUL_RM, OP_MUL_MR},
+                                  {OP_AND_RR, OP_AND_RM, OP_AND_MR}};
+      addBinary(ops[arithInst->getOp()->getID()], arithInst->getLval(), arithInst->getRval(),
+                function);
+
+    } else if (auto selfModInst = dynamic_cast<SelfModInst *>(I)) {
+      auto op = selfModInst->getOp()->getID() == SelfModOpID::INC ? OP_INC : OP_DEC;
+      auto &inst = add(op, function);
+      inst.dst = reg(selfModInst->getLval());
+
+    } else if (auto assignInst = dynamic_cast<AssignInst *>(I)) {
+      const DecodedOp ops[] = {OP_MOV_RR, OP_MOV_RM, OP_MOV_MR};
+      addBinary(ops, assignInst->getLval(), assignInst->getRval(), function);
+
+    } else if (auto cmpAssignInst = dynamic_cast<CompareAssignInst *>(I)) {
+      auto &inst = add(compareOps[cmpAssignInst->getOp()->getID()], function);
+      inst.dst = reg(cmpAssignInst->getLval());
+      inst.src = value(inst, cmpAssignInst->getCmpLval(), 0);
+      inst.src2 = value(inst, cmpAssignInst->getCmpRval(), 1);
+
+    } else if (auto callInst = dynamic_cast<CallInst *>(I)) {
+      auto argNum = callInst->getArgNum()->getVal();
+      auto argAmount = argNum > 6 ? 8 * (argNum - 6) : 0;
+      auto callee = callInst->getCallee();
+      auto indirect = dynamic_cast<Register *>(callee) != nullptr;
+      auto &inst = add(nativeCalls ? (indirect ? OP_CALL_NATIVE_INDIRECT : OP_CALL_NATIVE)
+                                   : (indirect ? OP_CALL_INDIRECT : OP_CALL),
+                       function);
+      // without native calls the caller has stored the return address below the arguments
+      inst.amount = nativeCalls ? argAmount : argAmount + 8;
+      if (indirect)
+        inst.src = reg(callee);
+      else
+        labelFixups.push_back({&inst.target, callee->getL1Token()});
+
+    } else if (dynamic_cast<PrintInst *>(I)) {
+      add(OP_PRINT, function);
+    } else if (dynamic_cast<InputInst *>(I)) {
+      add(OP_INPUT, function);
+    } else if (dynamic_cast<AllocateInst *>(I)) {
+      add(OP_ALLOCATE, function);
+    } else if (dynamic_cast<TupleErrorInst *>(I)) {
+      add(OP_TUPLE_ERROR, function);
+
+    } else if (auto tensorErrorInst = dynamic_cast<TensorErrorInst *>(I)) {
+      switch (tensorErrorInst->getNumber()->getVal()) {
+      case 1:
+        add(OP_ARRAY_TENSOR_ERROR_NULL, function);
+        break;
+      case 3:
+        add(OP_ARRAY_ERROR, function);
+        break;
+      case 4:
+        add(OP_TENSOR_ERROR, function);
+        break;
+      default:
+        throw std::runtime_error("unknown tensor error " + tensorErrorInst->getL1Inst());
+      }
+
+    } else if (auto setInst = dynamic_cast<SetInst *>(I)) {
+      auto &inst = add(OP_LEA, function);
+      inst.dst = reg(setInst->getLval());
+      inst.src = reg(setInst->getBase());
+      inst.src2 = reg(setInst->getOffset());
+      inst.offset = setInst->getScalar()->getVal();
+
+    } else if (auto labelInst = dynamic_cast<LabelInst *>(I)) {
+      // labels are not executed, they are resolved to the instruction that follows them
+      labels[labelInst->getLabel()->getL1Token()] = code.size();
+
+    } else if (auto gotoInst = dynamic_cast<GotoInst *>(I)) {
+      auto &inst = add(OP_JMP, function);
+      labelFixups.push_back({&inst.target, gotoInst->getLabel()->getL1Token()});
+
+    } else if (auto condJumpInst = dynamic_cast<CondJumpInst *>(I)) {
+      auto &inst = add(jumpOps[condJumpInst->getOp()->getID()], function);
+      inst.src = value(inst, condJumpInst->getLval(), 0);
+      inst.src2 = value(inst, condJumpInst->getRval(), 1);
+      labelFixups.push_back({&inst.target, condJumpInst->getLabel()->getL1Token()});
+
+    } else
+      throw std::runtime_error("unexpected instruction " + I->getL1Inst());
+  }
+
+  int64_t *registers;
+  std::unordered_map<std::string, size_t> labels;
+  std::unordered_map<std::string, size_t> functions;
+  std::vector<std::pair<DecodedInst **, std::string>> labelFixups;
+  std::vector<std::pair<int64_t *, std::string>> valueFixups;
+};
+
+/*
+ * Execute the decoded code from entry, with its return address on the stack. The arithmetic wraps
+ * around and the shifts are masked as on x86-64.
+ */
+template <bool counting>
+void execute(std::vector<DecodedInst> &code, DecodedInst *entry, int64_t *registers,
+             std::vector<int64_t> &counts) {
+#define DECODED_OP_LABEL(name) &&DO_##name,
+  static void *const handlers[] = {DECODED_OPS(DECODED_OP_LABEL)};
+#undef DECODED_OP_LABEL
+  for (auto &inst : code)
+    inst.handler = handlers[inst.op];
+
+  auto first = code.data();
+  auto &rsp = registers[RSP];
+  auto push = [&](int64_t value) {
+    rsp -= 8;
+    *(int64_t *)rsp = value;
+  };
+  /*
+   * A runtime call overwrites the caller saved registers, apart from its result, with a value that
+   * is neither a number nor a valid address, so that a value wrongly kept in one of them across the
+   * call is noticed as it would be in the generated code.
+   */
+  const RegisterID callerSaved[] = {RAX, RCX, RDX, RSI, RDI, R8, R9, R10, R11};
+  const int64_t poison = (int64_t)0x5a5a5a5a5a5a5a5aULL;
+  auto clobber = [&](int64_t result) {
+    for (auto reg : callerSaved)
+      registers[reg] = poison;
+    registers[RAX] = result;
+  };
+
+  push((int64_t)&code.back());
+  auto pc = entry;
+
+#define DISPATCH()                                                                                 \
+  do {                                                                                             \
+    if (counting)                                                                                  \
+      counts[pc - first]++;                                                                        \
+    goto *pc->handler;                                                                             \
+  } while (0)
+#define NEXT()                                                                                     \
+  do {                                                                                             \
+    pc++;                                                                                          \
+    DISPATCH();                                                                                    \
+  } while (0)
+#define MEMORY (*(int64_t *)(*pc->base + pc->offset))
+#define BINARY_HANDLERS(name, expression)                                                          \
+  DO_##name##_RR : {                                                                               \
+    uint64_t a = *pc->dst, b = *pc->src;                                                           \
+    *pc->dst = (int64_t)(expression);                                                              \
+    NEXT();                                                                                        \
+  }                                                                                                \
+  DO_##name##_RM : {                                                                               \
+    uint64_t a = *pc->dst, b = MEMORY;                                                             \
+    *pc->dst = (int64_t)(expression);                                                              \
+    NEXT();                                                                                        \
+  }                                                                                                \
+  DO_##name##_MR : {                                                                               \
+    uint64_t a = MEMORY, b = *pc->src;                                                             \
+    MEMORY = (int64_t)(expression);                                                                \
+    NEXT();                                                                                        \
+  }
+
+  DISPATCH();
+
+DO_MOV_RR:
+  *pc->dst = *pc->src;
+  NEXT();
+DO_MOV_RM:
+  *pc->dst = MEMORY;
+  NEXT();
+DO_MOV_MR:
+  MEMORY = *pc->src;
+  NEXT();
+
+  BINARY_HANDLERS(ADD, a + b)
+  BINARY_HANDLERS(SUB, a - b)
+  BINARY_HANDLERS(MUL, a * b)
+  BINARY_HANDLERS(AND, a & b)
+
+DO_SAL:
+  *pc->dst = (int64_t)((uint64_t)*pc->dst << (*pc->src & 63));
+  NEXT();
+DO_SAR:
+  *pc->dst >>= *pc->src & 63;
+  NEXT();
+DO_INC:
+  *pc->dst = (int64_t)((uint64_t)*pc->dst + 1);
+  NEXT();
+DO_DEC:
+  *pc->dst = (int64_t)((uint64_t)*pc->dst - 1);
+  NEXT();
+
+DO_LT:
+  *pc->dst = *pc->src < *pc->src2;
+  NEXT();
+DO_LE:
+  *pc->dst = *pc->src <= *pc->src2;
+  NEXT();
+DO_EQ:
+  *pc->dst = *pc->src == *pc->src2;
+  NEXT();
+DO_JLT:
+  pc = *pc->src < *pc->src2 ? pc->target : pc + 1;
+  DISPATCH();
+DO_JLE:
+  pc = *pc->src <= *pc->src2 ? pc->target : pc + 1;
+  DISPATCH();
+DO_JEQ:
+  pc = *pc->src == *pc->src2 ? pc->target : pc + 1;
+  DISPATCH();
+DO_JMP:
+  pc = pc->target;
+  DISPATCH();
+
+DO_LEA:
+  *pc->dst = (int64_t)((uint64_t)*pc->src + (uint64_t)*pc->src2 * pc->offset);
+  NEXT();
+DO_ENTER:
+  rsp -= pc->amount;
+  NEXT();
+DO_CALL:
+  rsp -= pc->amount;
+  pc = pc->target;
+  DISPATCH();
+DO_CALL_INDIRECT:
+  rsp -= pc->amount;
+  pc = (DecodedInst *)*pc->src;
+  DISPATCH();
+DO_CALL_NATIVE:
+  rsp -= pc->amount;
+  push((int64_t)(pc + 1));
+  pc = pc->target;
+  DISPATCH();
+DO_CALL_NATIVE_INDIRECT:
+  rsp -= pc->amount;
+  push((int64_t)(pc + 1));
+  pc = (DecodedInst *)*pc->src;
+  DISPATCH();
+DO_RET: {
+  rsp += pc->amount;
+  auto returnAddress = *(DecodedInst **)rsp;
+  rsp += 8 + pc->popped;
+  pc = returnAddress;
+  DISPATCH();
+}
+
+DO_PRINT:
+  runtimePrint(registers[RDI]);
+  clobber(poison);
+  NEXT();
+DO_INPUT:
+  clobber(runtimeInput());
+  NEXT();
+DO_ALLOCATE:
+  clobber(runtimeAllocate(registers[RDI], registers[RSI]));
+  NEXT();
+DO_TUPLE_ERROR:
+  runtimeTupleError(registers[RDI], registers[RSI], registers[RDX]);
+  NEXT();
+DO_ARRAY_TENSOR_ERROR_NULL:
+  runtimeArrayTensorErrorNull(registers[RDI]);
+  NEXT();
+DO_ARRAY_ERROR:
+  runtimeArrayError(registers[RDI], registers[RSI], registers[RDX]);
+  NEXT();
+DO_TENSOR_ERROR:
+  runtimeTensorError(registers[RDI], registers[RSI], registers[RDX], registers[RCX]);
+  NEXT();
+
+DO_HALT:
+  return;
+
+#undef BINARY_HANDLERS
+#undef MEMORY
+#undef NEXT
+#undef DISPATCH
+}
+
+std::vector<int64_t> interpret(Program &p, bool countInstructions) {
+  int64_t registers[16] = {};
+  Decoder decoder(p, registers);
+  debug("decoded " + std::to_string(decoder.code.size()) + " instructions");
+
+  // the stack of the program
+  const size_t stackSize = 8 << 20;
+  std::unique_ptr<int64_t[]> stack(new int64_t[stackSize]);
+  registers[RSP] = (int64_t)(stack.get() + stackSize);
+
+  if (!countInstructions) {
+    std::vector<int64_t> counts;
+    execute<false>(decoder.code, decoder.entry, registers, counts);
+    fflush(stdout);
+    return {};
+  }
+
+  std::vector<int64_t> counts(decoder.code.size(), 0);
+  execute<true>(decoder.code, decoder.entry, registers, counts);
+  fflush(stdout);
+  std::vector<int64_t> functionCounts(p.functions.size(), 0);
+  for (size_t i = 0; i < decoder.code.size(); i++)
+    if (decoder.code[i].function >= 0)
+      functionCounts[decoder.code[i].function] += counts[i];
+  return functionCounts;
+}
+
+} // namespace L1
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <L1.h>
+
+namespace L1 {
+
+/*
+ * Interpret a program from its entry point, on a stack of its own and with the runtime built in
+ * the interpreter. The program is first decoded to a flat array of instructions whose operands
+ * point to a register file and whose labels are resolved, the instructions are then executed by
+ * jumping from one handler to the next one (computed goto). The runtime calls overwrite the caller
+ * saved registers, as the generated code may.
+ *
+ * Returns the number of instructions executed in each function of the program when counting, in
+ * the order of p.functions, or nothing.
+ */
+std::vector<int64_t> interpret(Program &p, bool countInstructions);
+
+} // namespace L1
@@ -0,0 +1,313 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <L1.h>
+#include <x86.h>
+
+namespace L1 {
+
+const std::string x86RegToken[] = {"r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15",
+                                   "rax", "rbx", "rcx", "rdx", "rdi", "rsi", "rbp", "rsp"};
+const std::string x86RegToken8[] = {"r8b",  "r9b",  "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+                                    "al",   "bl",   "cl",   "dl",   "dil",  "sil",  "bpl",  "spl"};
+const std::string x86CondToken[] = {"e", "ne", "l", "ge", "le", "g"};
+
+X86Operand X86Operand::reg(RegisterID id) { return {REG, id, RSP, 1, 0, ""}; }
+X86Operand X86Operand::mem(RegisterID base, int64_t offset) {
+  return {MEM, base, RSP, 1, offset, ""};
+}
+X86Operand X86Operand::mem(RegisterID base, RegisterID index, int64_t scale) {
+  return {MEM, base, index, scale, 0, ""};
+}
+X86Operand X86Operand::imm(int64_t value) { return {IMM, RAX, RSP, 1, value, ""}; }
+X86Operand X86Operand::sym(std::string name) { return {SYM, RAX, RSP, 1, 0, name}; }
+
+bool X86Operand::operator==(const X86Operand &other) const {
+  if (kind != other.kind)
+    return false;
+  switch (kind) {
+  case REG:
+    return base == other.base;
+  case MEM:
+    return base == other.base && index == other.index && scale == other.scale &&
+           value == other.value;
+  case IMM:
+    return value == other.value;
+  default:
+    return name == other.name;
+  }
+}
+bool X86Operand::operator!=(const X86Operand &other) const { return !(*this == other); }
+
+std::string X86Operand::toStr(bool byte) const {
+  switch (kind) {
+  case REG:
+    return "%" + (byte ? x86RegToken8[base] : x86RegToken[base]);
+  case MEM:
+    if (index != RSP)
+      return "(%" + x86RegToken[base] + ", %" + x86RegToken[index] + ", " + std::to_string(scale) +
+             ")";
+    return std::to_string(value) + "(%" + x86RegToken[base] + ")";
+  case IMM:
+    return "$" + std::to_string(value);
+  default:
+    return name;
+  }
+}
+
+X86Inst::X86Inst(X86Opcode op, std::vector<X86Operand> operands)
+    : op{op}, cond{X86_E}, operands{operands} {
+  return;
+}
+X86Inst::X86Inst(X86Opcode op, X86Cond cond, std::vector<X86Operand> operands)
+    : op{op}, cond{cond}, operands{operands} {
+  return;
+}
+
+std::string X86Inst::toStr() const {
+  // an immediate symbol is the address of a label
+  auto source = [&]() {
+    auto &src = operands[0];
+    return src.kind == X86Operand::SYM ? "$" + src.name : src.toStr();
+  };
+  auto target = [&]() {
+    auto &dst = operands[0];
+    return dst.kind == X86Operand::SYM ? dst.name : "*" + dst.toStr();
+  };
+
+  switch (op) {
+  case X86_MOV:
+    return "movq " + source() + ", " + operands[1].toStr();
+  case X86_ADD:
+    return "addq " + source() + ", " + operands[1].toStr();
+  case X86_SUB:
+    return "subq " + source() + ", " + operands[1].toStr();
+  case X86_IMUL:
+    return "imulq " + source() + ", " + operands[1].toStr();
+  case X86_AND:
+    return "andq " + source() + ", " + operands[1].toStr();
+  case X86_XOR:
+    return "xorq " + source() + ", " + operands[1].toStr();
+  case X86_SAL:
+    return "salq " + operands[0].toStr(true) + ", " + operands[1].toStr();
+  case X86_SAR:
+    return "sarq " + operands[0].toStr(true) + ", " + operands[1].toStr();
+  case X86_INC:
+    return "inc " + operands[0].toStr();
+  case X86_DEC:
+    return "dec " + operands[0].toStr();
+  case X86_CMP:
+    return "cmpq " + source() + ", " + operands[1].toStr();
+  case X86_TEST:
+    return "testq " + operands[0].toStr() + ", " + operands[1].toStr();
+  case X86_SET:
+    return "set" + x86CondToken[cond] + " " + operands[0].toStr(true);
+  case X86_MOVZB:
+    return "movzbq " + operands[0].toStr(true) + ", " + operands[1].toStr();
+  case X86_LEA:
+    return "lea " + operands[0].toStr() + ", " + operands[1].toStr();
+  case X86_JMP:
+    return "jmp " + target();
+  case X86_JCC:
+    return "j" + x86CondToken[cond] + " " + target();
+  case X86_CALL:
+    return "call " + target();
+  case X86_RET:
+    return operands.empty() ? "retq" : "retq " + operands[0].toStr();
+  case X86_PUSH:
+    return "pushq " + operands[0].toStr();
+  case X86_POP:
+    return "popq " + operands[0].toStr();
+  case X86_LABEL:
+    return operands[0].name + ":";
+  }
+  return "<unknown-x86-inst>";
+}
+
+X86Operand lowerItem(Item *item) {
+  if (auto reg = dynamic_cast<Register *>(item))
+    return X86Operand::reg(reg->getID());
+  if (auto num = dynamic_cast<Number *>(item))
+    return X86Operand::imm(num->getVal());
+  if (auto mem = dynamic_cast<MemoryLocation *>(item))
+    return X86Operand::mem(mem->getReg()->getID(), mem->getOffset()->getVal());
+  return X86Operand::sym(item->getX86Token());
+}
+
+/*
+ * The comparison of a cmpq emitted for cmpLval op cmpRval, and its operands. A number can only be
+ * the first operand of cmpq, the condition is reversed when the L1 operands are swapped.
+ */
+X86Cond lowerCompare(CompareOp *op, Item *cmpLval, Item *cmpRval, std::vector<X86Operand> &cmp) {
+  auto reversed = true;
+  cmp = {lowerItem(cmpLval), lowerItem(cmpRval)};
+  if (dynamic_cast<Number *>(cmpRval)) {
+    cmp = {lowerItem(cmpRval), lowerItem(cmpLval)};
+    reversed = false;
+  }
+
+  switch (op->getID()) {
+  case CompareOpID::LESS_THAN:
+    return reversed ? X86_G : X86_L;
+  case CompareOpID::LESS_EQUAL:
+    return reversed ? X86_GE : X86_LE;
+  default:
+    return X86_E;
+  }
+}
+
+bool compareNumbers(CompareOp *op, Number *cmpLval, Number *cmpRval) {
+  switch (op->getID()) {
+  case CompareOpID::LESS_THAN:
+    return cmpLval->getVal() < cmpRval->getVal();
+  case CompareOpID::LESS_EQUAL:
+    return cmpLval->getVal() <= cmpRval->getVal();
+  default:
+    return cmpLval->getVal() == cmpRval->getVal();
+  }
+}
+
+void lowerInstruction(Function *f, Instruction *I, std::vector<X86Inst> &insts) {
+  auto rsp = X86Operand::reg(RSP);
+
+  if (dynamic_cast<RetInst *>(I)) {
+    int64_t argAmount = f->parameters > 6 ? (f->parameters - 6) * 8 : 0;
+    // with native calls the stack arguments are above the return address, retq pops them
+    auto amount = nativeCalls ? f->locals * 8 : argAmount + f->locals * 8;
+    if (amount > 0)
+      insts.push_back({X86_ADD, {X86Operand::imm(amount), rsp}});
+    if (nativeCalls && argAmount > 0)
+      insts.push_back({X86_RET, {X86Operand::imm(argAmount)}});
+    else
+      insts.push_back({X86_RET});
+
+  } else if (auto shiftInst = dynamic_cast<ShiftInst *>(I)) {
+    auto op = shiftInst->getOp()->getID() == ShiftOpID::LEFT ? X86_SAL : X86_SAR;
+    // the amount is in %cl when it is not a number
+    auto amount = lowerItem(shiftInst->getRval());
+    if (amount.kind == X86Operand::REG)
+      amount = X86Operand::reg(RCX);
+    insts.push_back({op, {amount, lowerItem(shiftInst->getLval())}});
+
+  } else if (auto arithInst = dynamic_cast<ArithInst *>(I)) {
+    const X86Opcode ops[] = {X86_ADD, X86_SUB, X86_IMUL, X86_AND};
+    insts.push_back({ops[arithInst->getOp()->getID()],
+                     {lowerItem(arithInst->getRval()), lowerItem(arithInst->getLval())}});
+
+  } else if (auto selfModInst = dynamic_cast<SelfModInst *>(I)) {
+    auto op = selfModInst->getOp()->getID() == SelfModOpID::INC ? X86_INC : X86_DEC;
+    insts.push_back({op, {lowerItem(selfModInst->getLval())}});
+
+  } else if (auto assignInst = dynamic_cast<AssignInst *>(I)) {
+    insts.push_back(
+        {X86_MOV, {lowerItem(assignInst->getRval()), lowerItem(assignInst->getLval())}});
+
+  } else if (auto cmpAssignInst = dynamic_cast<CompareAssignInst *>(I)) {
+    auto lval = lowerItem(cmpAssignInst->getLval());
+    auto cmpL = dynamic_cast<Number *>(cmpAssignInst->getCmpLval());
+    auto cmpR = dynamic_cast<Number *>(cmpAssignInst->getCmpRval());
+    if (cmpL && cmpR) {
+      auto value = compareNumbers(cmpAssignInst->getOp(), cmpL, cmpR) ? 1 : 0;
+      insts.push_back({X86_MOV, {X86Operand::imm(value), lval}});
+      return;
+    }
+    std::vector<X86Operand> cmp;
+    auto cond = lowerCompare(cmpAssignInst->getOp(), cmpAssignInst->getCmpLval(),
+                             cmpAssignInst->getCmpRval(), cmp);
+    insts.push_back({X86_CMP, cmp});
+    insts.push_back({X86_SET, cond, {lval}});
+    insts.push_back({X86_MOVZB, {lval, lval}});
+
+  } else if (auto callInst = dynamic_cast<CallInst *>(I)) {
+    auto argNum = callInst->getArgNum()->getVal();
+    auto argAmount = argNum > 6 ? 8 * (argNum - 6) : 0;
+    auto callee = lowerItem(callInst->getCallee());
+    if (nativeCalls) {
+      if (argAmount > 0)
+        insts.push_back({X86_SUB, {X86Operand::imm(argAmount), rsp}});
+      insts.push_back({X86_CALL, {callee}});
+    } else {
+      insts.push_back({X86_SUB, {X86Operand::imm(argAmount + 8), rsp}});
+      insts.push_back({X86_JMP, {callee}});
+    }
+
+  } else if (dynamic_cast<PrintInst *>(I)) {
+    insts.push_back({X86_CALL, {X86Operand::sym("print")}});
+  } else if (dynamic_cast<InputInst *>(I)) {
+    insts.push_back({X86_CALL, {X86Operand::sym("input")}});
+  } else if (dynamic_cast<AllocateInst *>(I)) {
+    insts.push_back({X86_CALL, {X86Operand::sym("allocate")}});
+  } else if (dynamic_cast<TupleErrorInst *>(I)) {
+    insts.push_back({X86_CALL, {X86Operand::sym("tuple_error")}});
+
+  } else if (auto tensorErrorInst = dynamic_cast<TensorErrorInst *>(I)) {
+    switch (tensorErrorInst->getNumber()->getVal()) {
+    case 1:
+      insts.push_back({X86_CALL, {X86Operand::sym("array_tensor_error_null")}});
+      break;
+    case 3:
+      insts.push_back({X86_CALL, {X86Operand::sym("array_error")}});
+      break;
+    case 4:
+      insts.push_back({X86_CALL, {X86Operand::sym("tensor_error")}});
+      break;
+    default:
+      throw std::runtime_error("unknown tensor error " + tensorErrorInst->getL1Inst());
+    }
+
+  } else if (auto setInst = dynamic_cast<SetInst *>(I)) {
+    auto address = X86Operand::mem(setInst->getBase()->getID(), setInst->getOffset()->getID(),
+                                   setInst->getScalar()->getVal());
+    insts.push_back({X86_LEA, {address, lowerItem(setInst->getLval())}});
+
+  } else if (auto labelInst = dynamic_cast<LabelInst *>(I)) {
+    insts.push_back({X86_LABEL, {lowerItem(labelInst->getLabel())}});
+
+  } else if (auto gotoInst = dynamic_cast<GotoInst *>(I)) {
+    insts.push_back({X86_JMP, {lowerItem(gotoInst->getLabel())}});
+
+  } else if (auto condJumpInst = dynamic_cast<CondJumpInst *>(I)) {
+    auto label = lowerItem(condJumpInst->getLabel());
+    auto cmpL = dynamic_cast<Number *>(condJumpInst->getLval());
+    auto cmpR = dynamic_cast<Number *>(condJumpInst->getRval());
+    if (cmpL && cmpR) {
+      // jump or fall through
+      if (compareNumbers(condJumpInst->getOp(), cmpL, cmpR))
+        insts.push_back({X86_JMP, {label}});
+      return;
+    }
+    std::vector<X86Operand> cmp;
+    auto cond =
+        lowerCompare(condJumpInst->getOp(), condJumpInst->getLval(), condJumpInst->getRval(), cmp);
+    insts.push_back({X86_CMP, cmp});
+    insts.push_back({X86_JCC, cond, {label}});
+
+  } else
+    throw std::runtime_error("unexpected instruction " + I->getL1Inst());
+}
+
+std::vector<X86Inst> lowerProgram(Program &p) {
+  std::vector<X86Inst> insts;
+  const RegisterID calleeSaved[] = {RBX, RBP, R12, R13, R14, R15};
+
+  // go saves the callee saved registers and calls the entry point
+  insts.push_back({X86_LABEL, {X86Operand::sym("go")}});
+  for (auto reg : calleeSaved)
+    insts.push_back({X86_PUSH, {X86Operand::reg(reg)}});
+  insts.push_back({X86_CALL, {X86Operand::sym("_" + p.entryPointLabel.substr(1))}});
+  for (int i = 5; i >= 0; i--)
+    insts.push_back({X86_POP, {X86Operand::reg(calleeSaved[i])}});
+  insts.push_back({X86_RET});
+
+  for (auto f : p.functions) {
+    insts.push_back({X86_LABEL, {X86Operand::sym("_" + f->name.substr(1))}});
+    if (f->locals > 0)
+      insts.push_back({X86_SUB, {X86Operand::imm(f->locals * 8), X86Operand::reg(RSP)}});
+    for (auto I : f->instructions)
+      lowerInstruction(f, I, insts);
+  }
+  return insts;
+}
+
+} // namespace L1
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <L1.h>
+
+namespace L1 {
+
+/*
+ * Structured form of the x86-64 instructions emitted for an L1 program, shared by the encoder and
+ * the optimizations working on the generated code.
+ */
+enum X86Opcode {
+  X86_MOV,
+  X86_ADD,
+  X86_SUB,
+  X86_IMUL,
+  X86_AND,
+  X86_XOR,
+  X86_SAL,
+  X86_SAR,
+  X86_INC,
+  X86_DEC,
+  X86_CMP,
+  X86_TEST,
+  X86_SET,
+  X86_MOVZB,
+  X86_LEA,
+  X86_JMP,
+  X86_JCC,
+  X86_CALL,
+  X86_RET,
+  X86_PUSH,
+  X86_POP,
+  X86_LABEL
+};
+
+enum X86Cond { X86_E, X86_NE, X86_L, X86_GE, X86_LE, X86_G };
+
+/*
+ * A register, a memory location base + index * scale + offset, an immediate, or a symbol: the
+ * target of a jump or a call, or the address of a label used as an immediate.
+ */
+class X86Operand {
+public:
+  enum Kind { REG, MEM, IMM, SYM };
+
+  static X86Operand reg(RegisterID id);
+  static X86Operand mem(RegisterID base, int64_t offset);
+  static X86Operand mem(RegisterID base, RegisterID index, int64_t scale);
+  static X86Operand imm(int64_t value);
+  static X86Operand sym(std::string name);
+
+  bool operator==(const X86Operand &other) const;
+  bool operator!=(const X86Operand &other) const;
+
+  // the 8 bit register is printed for setcc and movzbq
+  std::string toStr(bool byte = false) const;
+
+  Kind kind;
+  RegisterID base;
+  // RSP when the memory location has no index
+  RegisterID index;
+  int64_t scale;
+  // the immediate, or the offset of the memory location
+  int64_t value;
+  std::string name;
+};
+
+/*
+ * Operands are in AT&T order, the source before the destination. A jump is indirect when its
+ * target is a register.
+ */
+class X86Inst {
+public:
+  X86Inst(X86Opcode op, std::vector<X86Operand> operands = {});
+  X86Inst(X86Opcode op, X86Cond cond, std::vector<X86Operand> operands);
+
+  std::string toStr() const;
+
+  X86Opcode op;
+  X86Cond cond;
+  std::vector<X86Operand> operands;
+};
+
+/*
+ * Lower a program to the instructions written to prog.S by generate_code, starting with the go
+ * entry point. The labels are named as in the assembly.
+ */
+std::vector<X86Inst> lowerProgram(Program &p);
+
+} // namespace L1
@@ -0,0 +1,365 @@
+#include <cstdint>
+#include <elf.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <L1.h>
+#include <x86.h>
+#include <x86_encoder.h>
+
+namespace L1 {
+
+// hardware numbers of the registers, in RegisterID order
+const uint8_t hwReg[] = {8, 9, 10, 11, 12, 13, 14, 15, 0, 3, 1, 2, 7, 6, 5, 4};
+
+const uint8_t condCode[] = {0x4, 0x5, 0xc, 0xd, 0xe, 0xf};
+
+bool fitsInt8(int64_t value) { return value >= -128 && value <= 127; }
+bool fitsInt32(int64_t value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+/*
+ * A field of an instruction filled once the code is laid out: the displacement to a label, or a
+ * 32 bit relocation.
+ */
+class Fixup {
+public:
+  int64_t position;
+  int64_t size;
+  std::string symbol;
+  // relocation type, 0 for a displacement
+  uint32_t type;
+};
+
+class Encoder {
+public:
+  Encoder(const std::unordered_map<std::string, int64_t> &labelInsts)
+      : labelInsts{labelInsts} {
+    return;
+  }
+
+  std::vector<uint8_t> bytes;
+  std::vector<Fixup> fixups;
+
+  void encode(const X86Inst &inst, bool isLong) {
+    bytes.clear();
+    fixups.clear();
+    auto &ops = inst.operands;
+
+    switch (inst.op) {
+    case X86_MOV:
+      encodeMov(ops[0], ops[1]);
+      break;
+    case X86_ADD:
+      encodeAlu(0x01, 0, ops[0], ops[1]);
+      break;
+    case X86_SUB:
+      encodeAlu(0x29, 5, ops[0], ops[1]);
+      break;
+    case X86_AND:
+      encodeAlu(0x21, 4, ops[0], ops[1]);
+      break;
+    case X86_XOR:
+      encodeAlu(0x31, 6, ops[0], ops[1]);
+      break;
+    case X86_CMP:
+      encodeAlu(0x39, 7, ops[0], ops[1]);
+      break;
+    case X86_TEST:
+      encodeModRM(true, {0x85}, hwReg[ops[0].base], ops[1]);
+      break;
+    case X86_IMUL:
+      encodeImul(ops[0], ops[1]);
+      break;
+    case X86_SAL:
+      encodeShift(4, ops[0], ops[1]);
+      break;
+    case X86_SAR:
+      encodeShift(7, ops[0], ops[1]);
+      break;
+    case X86_INC:
+      encodeModRM(true, {0xff}, 0, ops[0]);
+      break;
+    case X86_DEC:
+      encodeModRM(true, {0xff}, 1, ops[0]);
+      break;
+    case X86_SET:
+      encodeModRM(false, {0x0f, (uint8_t)(0x90 | condCode[inst.cond])}, 0, ops[0], true);
+      break;
+    case X86_MOVZB:
+      encodeModRM(true, {0x0f, 0xb6}, hwReg[ops[1].base], ops[0]);
+      break;
+    case X86_LEA:
+      encodeModRM(true, {0x8d}, hwReg[ops[1].base], ops[0]);
+      break;
+    case X86_JMP:
+      if (ops[0].kind != X86Operand::SYM)
+        encodeModRM(false, {0xff}, 4, ops[0]);
+      else if (isLong)
+        encodeRel32({0xe9}, ops[0].name);
+      else
+        encodeRel8(0xeb, ops[0].name);
+      break;
+    case X86_JCC:
+      if (isLong)
+        encodeRel32({0x0f, (uint8_t)(0x80 | condCode[inst.cond])}, ops[0].name);
+      else
+        encodeRel8(0x70 | condCode[inst.cond], ops[0].name);
+      break;
+    case X86_CALL:
+      if (ops[0].kind != X86Operand::SYM)
+        encodeModRM(false, {0xff}, 2, ops[0]);
+      else
+        encodeRel32({0xe8}, ops[0].name);
+      break;
+    case X86_RET:
+      if (ops.empty())
+        bytes.push_back(0xc3);
+      else {
+        bytes.push_back(0xc2);
+        emitImm(ops[0].value, 2);
+      }
+      break;
+    case X86_PUSH:
+    case X86_POP: {
+      auto reg = hwReg[ops[0].base];
+      if (reg >= 8)
+        bytes.push_back(0x41);
+      bytes.push_back((inst.op == X86_PUSH ? 0x50 : 0x58) | (reg & 7));
+      break;
+    }
+    case X86_LABEL:
+      break;
+    }
+  }
+
+private:
+  const std::unordered_map<std::string, int64_t> &labelInsts;
+
+  void emitImm(int64_t value, int size) {
+    for (int i = 0; i < size; i++)
+      bytes.push_back((uint8_t)((uint64_t)value >> (8 * i)));
+  }
+
+  /*
+   * Prefix, opcode and ModRM (plus SIB and displacement) of an instruction whose r/m operand is
+   * rm and whose reg field is reg. A REX prefix is also needed to reach spl, bpl, sil and dil.
+   */
+  void encodeModRM(bool wide, std::vector<uint8_t> opcode, uint8_t reg, const X86Operand &rm,
+                   bool byteReg = false) {
+    uint8_t base = hwReg[rm.base];
+    uint8_t index = rm.kind == X86Operand::MEM && rm.index != RSP ? hwReg[rm.index] : 0;
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (rex != 0x40 || (byteReg && rm.kind == X86Operand::REG && base >= 4))
+      bytes.push_back(rex);
+    bytes.insert(bytes.end(), opcode.begin(), opcode.end());
+
+    reg &= 7;
+    if (rm.kind == X86Operand::REG) {
+      bytes.push_back(0xc0 | (reg << 3) | (base & 7));
+      return;
+    }
+    if (rm.kind != X86Operand::MEM)
+      throw std::runtime_error("unexpected operand " + rm.toStr());
+
+    // rbp and r13 as a base always have a displacement, rsp and r12 need a SIB byte
+    auto disp = rm.value;
+    uint8_t mod = 0x80;
+    if (disp == 0 && (base & 7) != 5)
+      mod = 0;
+    else if (fitsInt8(disp))
+      mod = 0x40;
+
+    if (rm.index != RSP) {
+      const uint8_t scaleBits[] = {0, 0, 1, 0, 2, 0, 0, 0, 3};
+      bytes.push_back(mod | (reg << 3) | 4);
+      bytes.push_back((scaleBits[rm.scale] << 6) | ((index & 7) << 3) | (base & 7));
+    } else {
+      bytes.push_back(mod | (reg << 3) | (base & 7));
+      if ((base & 7) == 4)
+        bytes.push_back(0x24);
+    }
+    if (mod == 0x40)
+      emitImm(disp, 1);
+    else if (mod == 0x80)
+      emitImm(disp, 4);
+  }
+
+  void encodeMov(const X86Operand &src, const X86Operand &dst) {
+    switch (src.kind) {
+    case X86Operand::REG:
+      encodeModRM(true, {0x89}, hwReg[src.base], dst);
+      return;
+    case X86Operand::MEM:
+      encodeModRM(true, {0x8b}, hwReg[dst.base], src);
+      return;
+    case X86Operand::IMM:
+      if (fitsInt32(src.value)) {
+        encodeModRM(true, {0xc7}, 0, dst);
+        emitImm(src.value, 4);
+        return;
+      }
+      if (dst.kind != X86Operand::REG)
+        throw std::runtime_error("immediate out of range " + src.toStr());
+      // movabs
+      bytes.push_back(0x48 | (hwReg[dst.base] >> 3));
+      bytes.push_back(0xb8 | (hwReg[dst.base] & 7));
+      emitImm(src.value, 8);
+      return;
+    case X86Operand::SYM:
+      encodeModRM(true, {0xc7}, 0, dst);
+      addField(src.name, R_X86_64_32S);
+      return;
+    }
+  }
+
+  /*
+   * add, sub, and, xor and cmp: opcode is the form storing a register to r/m, ext the reg field of
+   * the forms taking an immediate.
+   */
+  void encodeAlu(uint8_t opcode, uint8_t ext, const X86Operand &src, const X86Operand &dst) {
+    switch (src.kind) {
+    case X86Operand::REG:
+      encodeModRM(true, {opcode}, hwReg[src.base], dst);
+      return;
+    case X86Operand::MEM:
+      encodeModRM(true, {(uint8_t)(opcode + 2)}, hwReg[dst.base], src);
+      return;
+    case X86Operand::IMM:
+      if (fitsInt8(src.value)) {
+        encodeModRM(true, {0x83}, ext, dst);
+        emitImm(src.value, 1);
+      } else if (fitsInt32(src.value)) {
+        // rax has a shorter form
+        if (dst.kind == X86Operand::REG && dst.base == RAX) {
+          bytes.push_back(0x48);
+          bytes.push_back(opcode + 4);
+        } else
+          encodeModRM(true, {0x81}, ext, dst);
+        emitImm(src.value, 4);
+      } else
+        throw std::runtime_error("immediate out of range " + src.toStr());
+      return;
+    case X86Operand::SYM:
+      throw std::runtime_error("unexpected operand " + src.toStr());
+    }
+  }
+
+  void encodeImul(const X86Operand &src, const X86Operand &dst) {
+    if (src.kind != X86Operand::IMM) {
+      encodeModRM(true, {0x0f, 0xaf}, hwReg[dst.base], src);
+      return;
+    }
+    if (fitsInt8(src.value)) {
+      encodeModRM(true, {0x6b}, hwReg[dst.base], dst);
+      emitImm(src.value, 1);
+    } else if (fitsInt32(src.value)) {
+      encodeModRM(true, {0x69}, hwReg[dst.base], dst);
+      emitImm(src.value, 4);
+    } else
+      throw std::runtime_error("immediate out of range " + src.toStr());
+  }
+
+  void encodeShift(uint8_t ext, const X86Operand &amount, const X86Operand &dst) {
+    if (amount.kind == X86Operand::REG)
+      encodeModRM(true, {0xd3}, ext, dst);
+    else if (amount.value == 1)
+      encodeModRM(true, {0xd1}, ext, dst);
+    else {
+      encodeModRM(true, {0xc1}, ext, dst);
+      emitImm(amount.value, 1);
+    }
+  }
+
+  void encodeRel8(uint8_t opcode, std::string label) {
+    bytes.push_back(opcode);
+    fixups.push_back({(int64_t)bytes.size(), 1, label, 0});
+    bytes.push_back(0);
+  }
+
+  void encodeRel32(std::vector<uint8_t> opcode, std::string symbol) {
+    bytes.insert(bytes.end(), opcode.begin(), opcode.end());
+    // the runtime functions are linked later
+    addField(symbol, labelInsts.count(symbol) ? 0 : R_X86_64_PLT32);
+  }
+
+  void addField(std::string symbol, uint32_t type) {
+    fixups.push_back({(int64_t)bytes.size(), 4, symbol, type});
+    emitImm(0, 4);
+  }
+};
+
+MachineCode encodeProgram(const std::vector<X86Inst> &insts) {
+  MachineCode code;
+  std::unordered_map<std::string, int64_t> labelInsts;
+  for (size_t i = 0; i < insts.size(); i++)
+    if (insts[i].op == X86_LABEL) {
+      auto &name = insts[i].operands[0].name;
+      if (labelInsts.count(name))
+        throw std::runtime_error("label defined twice " + name);
+      labelInsts[name] = i;
+    }
+
+  // jumps to labels are relaxable, the other instructions are encoded once
+  Encoder encoder(labelInsts);
+  std::vector<std::vector<uint8_t>> bytes(insts.size());
+  std::vector<std::vector<Fixup>> fixups(insts.size());
+  std::vector<bool> relaxable(insts.size(), false), isLong(insts.size(), false);
+  for (size_t i = 0; i < insts.size(); i++) {
+    auto &inst = insts[i];
+    if ((inst.op == X86_JMP || inst.op == X86_JCC) && inst.operands[0].kind == X86Operand::SYM) {
+      if (!labelInsts.count(inst.operands[0].name))
+        throw std::runtime_error("undefined label " + inst.operands[0].name);
+      relaxable[i] = true;
+    }
+    encoder.encode(inst, false);
+    bytes[i] = encoder.bytes;
+    fixups[i] = encoder.fixups;
+  }
+
+  // a short jump whose displacement does not fit becomes near, until nothing changes
+  auto &offsets = code.offsets;
+  offsets.resize(insts.size() + 1);
+  auto changed = true;
+  while (changed) {
+    changed = false;
+    offsets[0] = 0;
+    for (size_t i = 0; i < insts.size(); i++)
+      offsets[i + 1] = offsets[i] + bytes[i].size();
+    for (size_t i = 0; i < insts.size(); i++) {
+      if (!relaxable[i] || isLong[i])
+        continue;
+      auto target = offsets[labelInsts.at(insts[i].operands[0].name)];
+      if (fitsInt8(target - offsets[i + 1]))
+        continue;
+      isLong[i] = true;
+      encoder.encode(insts[i], true);
+      bytes[i] = encoder.bytes;
+      fixups[i] = encoder.fixups;
+      changed = true;
+    }
+  }
+  offsets.pop_back();
+
+  for (auto &[name, i] : labelInsts)
+    code.labels[name] = offsets[i];
+  for (size_t i = 0; i < insts.size(); i++) {
+    for (auto &fixup : fixups[i]) {
+      auto field = offsets[i] + fixup.position;
+      if (fixup.type != 0) {
+        // calls are relative to the end of the field
+        auto addend = fixup.type == R_X86_64_PLT32 ? -4 : 0;
+        code.relocations.push_back({field, fixup.type, fixup.symbol, addend});
+        continue;
+      }
+      auto displacement = code.labels.at(fixup.symbol) - (offsets[i] + (int64_t)bytes[i].size());
+      for (int k = 0; k < fixup.size; k++)
+        bytes[i][fixup.position + k] = (uint8_t)((uint64_t)displacement >> (8 * k));
+    }
+    code.text.insert(code.text.end(), bytes[i].begin(), bytes[i].end());
+  }
+  return code;
+}
+
+} // namespace L1
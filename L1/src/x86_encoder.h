@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <x86.h>
+
+namespace L1 {
+
+/*
+ * A 32 bit field of the machine code to be patched with the address of a symbol, an ELF x86-64
+ * relocation type: R_X86_64_PLT32 for the calls to the runtime, R_X86_64_32S for the addresses of
+ * labels used as immediates.
+ */
+class Relocation {
+public:
+  int64_t offset;
+  uint32_t type;
+  std::string symbol;
+  int64_t addend;
+};
+
+/*
+ * Machine code of a program. The labels are resolved, the runtime functions it calls and the
+ * absolute addresses of its labels are left to relocations.
+ */
+class MachineCode {
+public:
+  std::vector<uint8_t> text;
+  std::unordered_map<std::string, int64_t> labels;
+  std::vector<Relocation> relocations;
+  // offset of each encoded instruction
+  std::vector<int64_t> offsets;
+};
+
+/*
+ * Encode instructions to x86-64 machine code, choosing the encodings GNU as chooses so that the
+ * result can be checked against the assembled prog.S. The jumps to labels start short and are
+ * relaxed to their near form until every displacement fits.
+ */
+MachineCode encodeProgram(const std::vector<X86Inst> &insts);
+
+} // namespace L1
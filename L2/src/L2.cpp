@@ -6,11 +6,11 @@
 
 namespace L2 {
 
-Symbol::Symbol(std::string name) : name{name} {}
+Symbol::Symbol(std::string name, Kind kind) : Value(kind), name{name} {}
 const std::string Symbol::getName() const { return name; }
 
 Register::Register(std::string name, std::string name8Bit, ID id)
-    : Symbol(name), name8Bit{name8Bit}, id{id} {}
+    : Symbol(name, REGISTER), name8Bit{name8Bit}, id{id} {}
 std::string Register::toStr() const { return name; }
 void Register::accept(Visitor &visitor) const { visitor.visit(this); }
 const std::string Register::getName8Bit() const { return name8Bit; }
@@ -57,16 +57,16 @@ const std::vector<const Register *> Register::argRegisters = {
     enumMap.at(ID::RDI), enumMap.at(ID::RSI), enumMap.at(ID::RDX),
     enumMap.at(ID::RCX), enumMap.at(ID::R8),  enumMap.at(ID::R9)};
 
-Variable::Variable(std::string name) : Symbol(name) {}
+Variable::Variable(std::string name) : Symbol(name, VARIABLE) {}
 std::string Variable::toStr() const { return name; }
 void Variable::accept(Visitor &visitor) const { visitor.visit(this); }
 
-Number::Number(int64_t val) : val{val} {}
+Number::Number(int64_t val) : Value(NUMBER), val{val} {}
 int64_t Number::getVal() const { return val; }
 std::string Number::toStr() const { return std::to_string(val); }
 void Number::accept(Visitor &visitor) const { visitor.visit(this); }
 
-CompareOp::CompareOp(std::string name) : name{name} {}
+CompareOp::CompareOp(std::string name) : Item(COMPARE_OP), name{name} {}
 CompareOp *CompareOp::getCompareOp(ID id) { return enumMap.at(id); }
 const std::string CompareOp::getName() const { return name; }
 std::string CompareOp::toStr() const { return name; }
@@ -76,7 +76,7 @@ const std::unordered_map<CompareOp::ID, CompareOp *> CompareOp::enumMap = {
     {ID::LESS_EQUAL, new CompareOp("<=")},
     {ID::EQUAL, new CompareOp("=")}};
 
-ShiftOp::ShiftOp(std::string name) : name{name} {}
+ShiftOp::ShiftOp(std::string name) : Item(SHIFT_OP), name{name} {}
 ShiftOp *ShiftOp::getShiftOp(ID id) { return enumMap.at(id); }
 const std::string ShiftOp::getName() const { return name; }
 std::string ShiftOp::toStr() const { return name; }
@@ -84,7 +84,7 @@ void ShiftOp::accept(Visitor &visitor) const { visitor.visit(this); }
 const std::unordered_map<ShiftOp::ID, ShiftOp *> ShiftOp::enumMap = {
     {ID::LEFT, new ShiftOp("<<=")}, {ID::RIGHT, new ShiftOp(">>=")}};
 
-ArithOp::ArithOp(std::string name) : name{name} {}
+ArithOp::ArithOp(std::string name) : Item(ARITH_OP), name{name} {}
 ArithOp *ArithOp::getArithOp(ID id) { return enumMap.at(id); }
 const std::string ArithOp::getName() const { return name; }
 std::string ArithOp::toStr() const { return name; }
@@ -94,7 +94,7 @@ const std::unordered_map<ArithOp::ID, ArithOp *> ArithOp::enumMap = {{ID::ADD, n
                                                                      {ID::MUL, new ArithOp("*=")},
                                                                      {ID::AND, new ArithOp("&=")}};
 
-SelfModOp::SelfModOp(std::string name) : name{name} {}
+SelfModOp::SelfModOp(std::string name) : Item(SELF_MOD_OP), name{name} {}
 SelfModOp *SelfModOp::getSelfModOp(ID id) { return enumMap.at(id); }
 const std::string SelfModOp::getName() const { return name; }
 std::string SelfModOp::toStr() const { return name; }
@@ -103,23 +103,23 @@ const std::unordered_map<SelfModOp::ID, SelfModOp *> SelfModOp::enumMap = {
     {ID::INC, new SelfModOp("++")}, {ID::DEC, new SelfModOp("--")}};
 
 MemoryLocation::MemoryLocation(const Symbol *base, const Number *offset)
-    : base{base}, offset{offset} {}
+    : Item(MEMORY_LOCATION), base{base}, offset{offset} {}
 const Symbol *MemoryLocation::getBase() const { return base; }
 const Number *MemoryLocation::getOffset() const { return offset; }
 std::string MemoryLocation::toStr() const { return "mem " + base->toStr() + " " + offset->toStr(); }
 void MemoryLocation::accept(Visitor &visitor) const { visitor.visit(this); }
 
-StackLocation::StackLocation(const Number *offset) : offset{offset} {}
+StackLocation::StackLocation(const Number *offset) : Item(STACK_LOCATION), offset{offset} {}
 const Number *StackLocation::getOffset() const { return offset; }
 std::string StackLocation::toStr() const { return "stack-arg " + offset->toStr(); }
 void StackLocation::accept(Visitor &visitor) const { visitor.visit(this); }
 
-FunctionName::FunctionName(std::string name) : name{name} {}
+FunctionName::FunctionName(std::string name) : Item(FUNCTION_NAME), name{name} {}
 std::string FunctionName::getName() const { return name; }
 std::string FunctionName::toStr() const { return name; }
 void FunctionName::accept(Visitor &visitor) const { visitor.visit(this); }
 
-Label::Label(std::string name) : name{name} {}
+Label::Label(std::string name) : Item(LABEL), name{name} {}
 std::string Label::getName() const { return name; }
 std::string Label::toStr() const { return name; }
 void Label::accept(Visitor &visitor) const { visitor.visit(this); }
@@ -127,11 +127,12 @@ void Label::accept(Visitor &visitor) const { visitor.visit(this); }
 /*
  *  Instructions.
  */
+RetInst::RetInst() : Instruction(RET) {}
 std::string RetInst::toStr() const { return "return"; }
 void RetInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
 ShiftInst::ShiftInst(const ShiftOp *op, const Symbol *lval, const Value *rval)
-    : op{op}, lval{lval}, rval{rval} {}
+    : Instruction(SHIFT), op{op}, lval{lval}, rval{rval} {}
 const ShiftOp *ShiftInst::getOp() const { return op; }
 const Symbol *ShiftInst::getLval() const { return lval; }
 const Value *ShiftInst::getRval() const { return rval; }
@@ -141,7 +142,7 @@ std::string ShiftInst::toStr() const {
 void ShiftInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
 ArithInst::ArithInst(const ArithOp *op, const Item *lval, const Item *rval)
-    : op{op}, lval{lval}, rval{rval} {}
+    : Instruction(ARITH), op{op}, lval{lval}, rval{rval} {}
 const ArithOp *ArithInst::getOp() const { return op; }
 const Item *ArithInst::getLval() const { return lval; }
 const Item *ArithInst::getRval() const { return rval; }
@@ -150,13 +151,15 @@ std::string ArithInst::toStr() const {
 }
 void ArithInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-SelfModInst::SelfModInst(const SelfModOp *op, const Symbol *lval) : op{op}, lval{lval} {}
+SelfModInst::SelfModInst(const SelfModOp *op, const Symbol *lval)
+    : Instruction(SELF_MOD), op{op}, lval{lval} {}
 const SelfModOp *SelfModInst::getOp() const { return op; }
 const Symbol *SelfModInst::getLval() const { return lval; }
 std::string SelfModInst::toStr() const { return lval->toStr() + op->toStr(); }
 void SelfModInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-AssignInst::AssignInst(const Item *lval, const Item *rval) : lval{lval}, rval{rval} {}
+AssignInst::AssignInst(const Item *lval, const Item *rval)
+    : Instruction(ASSIGN), lval{lval}, rval{rval} {}
 const Item *AssignInst::getLval() const { return lval; }
 const Item *AssignInst::getRval() const { return rval; }
 std::string AssignInst::toStr() const { return lval->toStr() + " <- " + rval->toStr(); }
@@ -164,7 +167,7 @@ void AssignInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
 CompareAssignInst::CompareAssignInst(const Symbol *lval, const CompareOp *op, const Value *cmpLval,
                                      const Value *cmpRval)
-    : lval{lval}, op{op}, cmpLval{cmpLval}, cmpRval{cmpRval} {}
+    : Instruction(COMPARE_ASSIGN), lval{lval}, op{op}, cmpLval{cmpLval}, cmpRval{cmpRval} {}
 const Symbol *CompareAssignInst::getLval() const { return lval; }
 const CompareOp *CompareAssignInst::getOp() const { return op; }
 const Value *CompareAssignInst::getCmpLval() const { return cmpLval; }
@@ -174,31 +177,39 @@ std::string CompareAssignInst::toStr() const {
 }
 void CompareAssignInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-CallInst::CallInst(const Item *callee, const Number *argNum) : callee{callee}, argNum{argNum} {}
+bool nativeCalls = false;
+
+CallInst::CallInst(const Item *callee, const Number *argNum)
+    : Instruction(CALL), callee{callee}, argNum{argNum} {}
 const Item *CallInst::getCallee() const { return callee; }
 const Number *CallInst::getArgNum() const { return argNum; }
 std::string CallInst::toStr() const { return "call " + callee->toStr() + " " + argNum->toStr(); }
 void CallInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
+PrintInst::PrintInst() : Instruction(PRINT) {}
 std::string PrintInst::toStr() const { return "call print 1"; }
 void PrintInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
+InputInst::InputInst() : Instruction(INPUT) {}
 std::string InputInst::toStr() const { return "call input 0"; }
 void InputInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
+AllocateInst::AllocateInst() : Instruction(ALLOCATE) {}
 std::string AllocateInst::toStr() const { return "call allocate 2"; }
 void AllocateInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
+TupleErrorInst::TupleErrorInst() : Instruction(TUPLE_ERROR) {}
 std::string TupleErrorInst::toStr() const { return "call tuple-error 3"; }
 void TupleErrorInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-TensorErrorInst::TensorErrorInst(const Number *argNum) : argNum(argNum) {}
+TensorErrorInst::TensorErrorInst(const Number *argNum)
+    : Instruction(TENSOR_ERROR), argNum(argNum) {}
 const Number *TensorErrorInst::getArgNum() const { return argNum; }
 std::string TensorErrorInst::toStr() const { return "call tensor-error " + argNum->toStr(); }
 void TensorErrorInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
 SetInst::SetInst(const Symbol *lval, const Symbol *base, const Symbol *offset, const Number *scalar)
-    : lval{lval}, base{base}, offset{offset}, scalar{scalar} {}
+    : Instruction(SET), lval{lval}, base{base}, offset{offset}, scalar{scalar} {}
 const Symbol *SetInst::getLval() const { return lval; }
 const Symbol *SetInst::getBase() const { return base; }
 const Symbol *SetInst::getOffset() const { return offset; }
@@ -208,19 +219,19 @@ std::string SetInst::toStr() const {
 }
 void SetInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-LabelInst::LabelInst(const Label *label) : label{label} {}
+LabelInst::LabelInst(const Label *label) : Instruction(LABEL), label{label} {}
 const Label *LabelInst::getLabel() const { return label; }
 std::string LabelInst::toStr() const { return label->toStr(); }
 void LabelInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
-GotoInst::GotoInst(const Label *label) : label{label} {}
+GotoInst::GotoInst(const Label *label) : Instruction(GOTO), label{label} {}
 const Label *GotoInst::getLabel() const { return label; }
 std::string GotoInst::toStr() const { return "goto " + label->toStr(); }
 void GotoInst::accept(Visitor &visitor) const { visitor.visit(this); }
 
 CondJumpInst::CondJumpInst(const CompareOp *op, const Value *lval, const Value *rval,
                            const Label *label)
-    : op{op}, lval{lval}, rval{rval}, label{label} {}
+    : Instruction(COND_JUMP), op{op}, lval{lval}, rval{rval}, label{label} {}
 const Label *CondJumpInst::getLabel() const { return label; }
 const Value *CondJumpInst::getLval() const { return lval; }
 const Value *CondJumpInst::getRval() const { return rval; }
@@ -243,7 +254,7 @@ const Instruction *BasicBlock::getTerminator() const { return instructions.back(
 
 Function::Function(std::string name) : name{name} {
   // start with an empty basic block
-  basicBlocks.push_back(new BasicBlock());
+  basicBlocks.push_back(arena.create<BasicBlock>());
 }
 std::string Function::getName() const { return name; }
 int64_t Function::getParamNum() const  { return paramNum; }
@@ -254,7 +265,7 @@ BasicBlock *Function::getCurrBasicBlock() const { return basicBlocks.back(); }
 void Function::popCurrBasicBlock() { basicBlocks.pop_back(); }
 const Variable *Function::getVariable(std::string name) {
   if (variables.find(name) == variables.end())
-    variables[name] = new Variable(name);
+    variables[name] = arena.create<Variable>(name);
   return variables[name];
 }
 bool Function::hasVariable(std::string name) const {
@@ -263,6 +274,33 @@ bool Function::hasVariable(std::string name) const {
 const std::unordered_map<std::string, const Variable *> &Function::getVariables() const {
   return variables;
 }
+const Number *Function::getNumber(int64_t val) {
+  auto &num = numbers[val];
+  if (num == nullptr)
+    num = arena.create<Number>(val);
+  return num;
+}
+const MemoryLocation *Function::getMemoryLocation(const Symbol *base, const Number *offset) {
+  auto &mem = memoryLocations[base][offset];
+  if (mem == nullptr)
+    mem = arena.create<MemoryLocation>(base, offset);
+  return mem;
+}
+const StackLocation *Function::getStackLocation(const Number *offset) {
+  auto &stack = stackLocations[offset];
+  if (stack == nullptr)
+    stack = arena.create<StackLocation>(offset);
+  return stack;
+}
+Arena &Function::getArena() const { return arena; }
+void Function::release() {
+  basicBlocks.clear();
+  variables.clear();
+  numbers.clear();
+  memoryLocations.clear();
+  stackLocations.clear();
+  arena.reset();
+}
 
 std::string Program::getEntryPointLabel() const { return entryPointLabel; }
 void Program::setEntryPointLabel(std::string label) { entryPointLabel = label; }
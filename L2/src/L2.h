@@ -1,5 +1,7 @@
 #pragma once
 
+#include <arena.h>
+#include <casting.h>
 #include <helper.h>
 #include <string>
 #include <unordered_map>
@@ -12,15 +14,47 @@ class Visitor;
 
 class Item {
 public:
+  /*
+   * Concrete class of an item, see casting.h.
+   * The values come first, starting with the symbols, so their tests are range checks.
+   */
+  enum Kind {
+    REGISTER,
+    VARIABLE,
+    NUMBER,
+    COMPARE_OP,
+    SHIFT_OP,
+    ARITH_OP,
+    SELF_MOD_OP,
+    MEMORY_LOCATION,
+    STACK_LOCATION,
+    FUNCTION_NAME,
+    LABEL
+  };
+
+  Kind getKind() const { return kind; }
   virtual std::string toStr() const = 0;
   virtual void accept(Visitor &visitor) const = 0;
+
+protected:
+  Item(Kind kind) : kind{kind} {}
+
+private:
+  const Kind kind;
 };
 
-class Value : public Item {};
+class Value : public Item {
+public:
+  static bool classof(const Item *item) { return item->getKind() <= NUMBER; }
+
+protected:
+  Value(Kind kind) : Item(kind) {}
+};
 
 class Symbol : public Value {
 public:
-  Symbol(std::string name);
+  static bool classof(const Item *item) { return item->getKind() <= VARIABLE; }
+  Symbol(std::string name, Kind kind);
   const std::string getName() const;
 
 protected:
@@ -29,6 +63,7 @@ protected:
 
 class Register : public Symbol {
 public:
+  static bool classof(const Item *item) { return item->getKind() == REGISTER; }
   enum ID { R8, R9, R10, R11, R12, R13, R14, R15, RAX, RBX, RCX, RDX, RDI, RSI, RBP, RSP };
   static const Register *getRegister(ID id);
 
@@ -55,6 +90,7 @@ private:
 
 class Variable : public Symbol {
 public:
+  static bool classof(const Item *item) { return item->getKind() == VARIABLE; }
   Variable(std::string name);
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
@@ -62,6 +98,7 @@ public:
 
 class Number : public Value {
 public:
+  static bool classof(const Item *item) { return item->getKind() == NUMBER; }
   Number(int64_t val);
   int64_t getVal() const;
   std::string toStr() const override;
@@ -73,6 +110,7 @@ private:
 
 class CompareOp : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == COMPARE_OP; }
   enum ID { LESS_THAN, LESS_EQUAL, EQUAL };
   static CompareOp *getCompareOp(ID id);
 
@@ -89,6 +127,7 @@ private:
 
 class ShiftOp : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == SHIFT_OP; }
   enum ID { LEFT, RIGHT };
   static ShiftOp *getShiftOp(ID id);
 
@@ -105,6 +144,7 @@ private:
 
 class ArithOp : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == ARITH_OP; }
   enum ID { ADD, SUB, MUL, AND };
   static ArithOp *getArithOp(ID id);
 
@@ -121,6 +161,7 @@ private:
 
 class SelfModOp : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == SELF_MOD_OP; }
   enum ID { INC, DEC };
   static SelfModOp *getSelfModOp(ID id);
 
@@ -137,6 +178,7 @@ private:
 
 class MemoryLocation : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == MEMORY_LOCATION; }
   MemoryLocation(const Symbol *base, const Number *offset);
   const Symbol *getBase() const;
   const Number *getOffset() const;
@@ -150,6 +192,7 @@ private:
 
 class StackLocation : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == STACK_LOCATION; }
   StackLocation(const Number *offset);
   const Number *getOffset() const;
   std::string toStr() const override;
@@ -161,6 +204,7 @@ private:
 
 class FunctionName : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == FUNCTION_NAME; }
   FunctionName(std::string name);
   std::string getName() const;
   std::string toStr() const override;
@@ -172,6 +216,7 @@ private:
 
 class Label : public Item {
 public:
+  static bool classof(const Item *item) { return item->getKind() == LABEL; }
   Label(std::string name);
   std::string getName() const;
   std::string toStr() const override;
@@ -186,8 +231,37 @@ private:
  */
 class Instruction {
 public:
+  /*
+   * Concrete class of an instruction, see casting.h.
+   */
+  enum Kind {
+    RET,
+    SHIFT,
+    ARITH,
+    SELF_MOD,
+    ASSIGN,
+    COMPARE_ASSIGN,
+    CALL,
+    PRINT,
+    INPUT,
+    ALLOCATE,
+    TUPLE_ERROR,
+    TENSOR_ERROR,
+    SET,
+    LABEL,
+    GOTO,
+    COND_JUMP
+  };
+
+  Kind getKind() const { return kind; }
   virtual std::string toStr() const = 0;
   virtual void accept(Visitor &visitor) const = 0;
+
+protected:
+  Instruction(Kind kind) : kind{kind} {}
+
+private:
+  const Kind kind;
 };
 
 /*
@@ -195,12 +269,15 @@ public:
  */
 class RetInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == RET; }
+  RetInst();
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
 };
 
 class ShiftInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == SHIFT; }
   ShiftInst(const ShiftOp *op, const Symbol *lval, const Value *rval);
   const ShiftOp *getOp() const;
   const Symbol *getLval() const;
@@ -216,6 +293,7 @@ private:
 
 class ArithInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == ARITH; }
   ArithInst(const ArithOp *op, const Item *lval, const Item *rval);
   const ArithOp *getOp() const;
   const Item *getLval() const;
@@ -231,6 +309,7 @@ private:
 
 class SelfModInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == SELF_MOD; }
   SelfModInst(const SelfModOp *op, const Symbol *lval);
   const SelfModOp *getOp() const;
   const Symbol *getLval() const;
@@ -244,6 +323,7 @@ private:
 
 class AssignInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == ASSIGN; }
   AssignInst(const Item *lval, const Item *rval);
   const Item *getLval() const;
   const Item *getRval() const;
@@ -257,6 +337,7 @@ private:
 
 class CompareAssignInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == COMPARE_ASSIGN; }
   CompareAssignInst(const Symbol *lval, const CompareOp *op, const Value *cmpLval,
                     const Value *cmpRval);
   const Symbol *getLval() const;
@@ -275,6 +356,7 @@ private:
 
 class CallInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == CALL; }
   CallInst(const Item *callee, const Number *argNum);
   const Item *getCallee() const;
   const Number *getArgNum() const;
@@ -286,32 +368,48 @@ private:
   const Number *argNum;
 };
 
+/*
+ * By default a call returns to the label stored at mem rsp -8 by the caller, which starts the next
+ * basic block. With native calls, the return address is pushed by the call itself and the call
+ * returns to the next instruction; the stack arguments then sit above the return address.
+ */
+extern bool nativeCalls;
+
 class PrintInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == PRINT; }
+  PrintInst();
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
 };
 
 class InputInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == INPUT; }
+  InputInst();
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
 };
 
 class AllocateInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == ALLOCATE; }
+  AllocateInst();
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
 };
 
 class TupleErrorInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == TUPLE_ERROR; }
+  TupleErrorInst();
   std::string toStr() const override;
   void accept(Visitor &visitor) const override;
 };
 
 class TensorErrorInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == TENSOR_ERROR; }
   TensorErrorInst(const Number *number);
   const Number *getArgNum() const;
   std::string toStr() const override;
@@ -323,6 +421,7 @@ private:
 
 class SetInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == SET; }
   SetInst(const Symbol *lval, const Symbol *base, const Symbol *offset, const Number *scalar);
   const Symbol *getLval() const;
   const Symbol *getBase() const;
@@ -340,6 +439,7 @@ private:
 
 class LabelInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == LABEL; }
   LabelInst(const Label *label);
   const Label *getLabel() const;
   std::string toStr() const override;
@@ -351,6 +451,7 @@ private:
 
 class GotoInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == GOTO; }
   GotoInst(const Label *label);
   const Label *getLabel() const;
   std::string toStr() const override;
@@ -362,6 +463,7 @@ private:
 
 class CondJumpInst : public Instruction {
 public:
+  static bool classof(const Instruction *inst) { return inst->getKind() == COND_JUMP; }
   CondJumpInst(const CompareOp *op, const Value *lval, const Value *rval, const Label *label);
   const CompareOp *getOp() const;
   const Value *getLval() const;
@@ -400,8 +502,9 @@ private:
   std::unordered_set<BasicBlock *> predecessors;
   std::unordered_set<BasicBlock *> successors;
 
-  friend void spillInBB(BasicBlock *BB);
-  friend bool doElimination(Function *F);
+  friend class Spiller;
+  friend class DeadCodeEliminator;
+  friend class LiveRangeSplitter;
 };
 
 class Function {
@@ -418,11 +521,35 @@ public:
   bool hasVariable(std::string name) const;
   const std::unordered_map<std::string, const Variable *> &getVariables() const;
 
+  /*
+   * Numbers and memory locations are interned: equal operands of the function are the same
+   * object and can be compared by address.
+   */
+  const Number *getNumber(int64_t val);
+  const MemoryLocation *getMemoryLocation(const Symbol *base, const Number *offset);
+  const StackLocation *getStackLocation(const Number *offset);
+
+  /*
+   * Arena owning the blocks, instructions and items of the function, and the results of the
+   * analyses run on it. Analyses only see a const function but still allocate their results here.
+   */
+  Arena &getArena() const;
+
+  /*
+   * Drop the body of the function and everything allocated in its arena, once it has been emitted.
+   */
+  void release();
+
 private:
   std::string name;
   int64_t paramNum;
+  mutable Arena arena;
   std::vector<BasicBlock *> basicBlocks;
   std::unordered_map<std::string, const Variable *> variables;
+  std::unordered_map<int64_t, const Number *> numbers;
+  std::unordered_map<const Symbol *, std::unordered_map<const Number *, const MemoryLocation *>>
+      memoryLocations;
+  std::unordered_map<const Number *, const StackLocation *> stackLocations;
 };
 
 class Program {
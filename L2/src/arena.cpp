@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <arena.h>
+
+namespace L2 {
+
+const static size_t chunkSize = 64 * 1024;
+
+Arena::~Arena() {
+  reset();
+  for (auto &chunk : chunks)
+    delete[] chunk.data;
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+  auto aligned = (char *)(((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1));
+  if (cursor == nullptr || aligned + size > limit) {
+    newChunk(size + align);
+    aligned = (char *)(((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1));
+  }
+  cursor = aligned + size;
+  bytesAllocated += size;
+  return aligned;
+}
+
+void Arena::newChunk(size_t minSize) {
+  auto size = std::max(chunkSize, minSize);
+  chunks.push_back({new char[size], size});
+  cursor = chunks.back().data;
+  limit = cursor + size;
+}
+
+void Arena::reset() {
+  for (auto it = destructors.rbegin(); it != destructors.rend(); it++)
+    if (it->destructor != nullptr)
+      it->destructor(it->object);
+  destructors.clear();
+
+  // the first chunk is kept, the other ones are given back
+  for (size_t i = 1; i < chunks.size(); i++)
+    delete[] chunks[i].data;
+  if (chunks.size() > 1)
+    chunks.resize(1);
+  cursor = chunks.empty() ? nullptr : chunks.front().data;
+  limit = chunks.empty() ? nullptr : cursor + chunks.front().size;
+  bytesAllocated = 0;
+}
+
+int64_t Arena::getBytesAllocated() const { return bytesAllocated; }
+
+} // namespace L2
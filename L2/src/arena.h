@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace L2 {
+
+/*
+ * Bump allocator owning the objects built while compiling one function.
+ *
+ * Memory is carved out of large chunks and is only given back by reset(), which also runs the
+ * destructors of the objects that need one, in reverse order of creation. Objects whose
+ * destructor is trivial (most items and instructions) cost a pointer bump.
+ *
+ * An arena is not synchronized, it must only be used by the thread compiling its function.
+ */
+class Arena {
+public:
+  Arena() = default;
+  ~Arena();
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      destructors.push_back({object, [](void *p) { ((T *)p)->~T(); }});
+    return object;
+  }
+
+  /*
+   * Run the destructor of an object before the arena is reset, e.g. to release the containers of
+   * an analysis result that is rebuilt. Its memory is only reclaimed by reset().
+   */
+  template <typename T> void destroy(T *object) {
+    if (std::is_trivially_destructible<T>::value)
+      return;
+    // the object is usually one of the last ones created
+    for (auto it = destructors.rbegin(); it != destructors.rend(); it++)
+      if (it->object == object) {
+        it->destructor(object);
+        it->destructor = nullptr;
+        return;
+      }
+  }
+
+  /*
+   * Destroy every object and keep the first chunk for reuse.
+   */
+  void reset();
+
+  int64_t getBytesAllocated() const;
+
+private:
+  struct Chunk {
+    char *data;
+    size_t size;
+  };
+
+  struct Destructor {
+    void *object;
+    void (*destructor)(void *);
+  };
+
+  std::vector<Chunk> chunks;
+  char *cursor = nullptr, *limit = nullptr;
+  std::vector<Destructor> destructors;
+  int64_t bytesAllocated = 0;
+
+  void *allocate(size_t size, size_t align);
+  void newChunk(size_t minSize);
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+};
+
+} // namespace L2
@@ -0,0 +1,90 @@
+#include <cstddef>
+
+#include <bit_vector.h>
+
+namespace L2 {
+
+static int64_t wordsFor(int64_t size) {
+  // round up to a multiple of 4 words
+  return ((size + 255) >> 8) << 2;
+}
+
+BitVector::BitVector(int64_t size) : numBits{size}, words(wordsFor(size), 0) {}
+
+int64_t BitVector::size() const { return numBits; }
+
+void BitVector::resize(int64_t size) {
+  numBits = size;
+  words.resize(wordsFor(size), 0);
+}
+
+void BitVector::clear() {
+  for (auto &word : words)
+    word = 0;
+}
+
+bool BitVector::any() const {
+  uint64_t acc = 0;
+  for (auto word : words)
+    acc |= word;
+  return acc != 0;
+}
+
+int64_t BitVector::count() const {
+  int64_t result = 0;
+  for (auto word : words)
+    result += __builtin_popcountll(word);
+  return result;
+}
+
+BitVector &BitVector::operator|=(const BitVector &other) {
+  auto n = words.size();
+  auto dst = words.data();
+  auto src = other.words.data();
+  for (size_t i = 0; i < n; i++)
+    dst[i] |= src[i];
+  return *this;
+}
+
+BitVector &BitVector::operator&=(const BitVector &other) {
+  auto n = words.size();
+  auto dst = words.data();
+  auto src = other.words.data();
+  for (size_t i = 0; i < n; i++)
+    dst[i] &= src[i];
+  return *this;
+}
+
+BitVector &BitVector::operator-=(const BitVector &other) {
+  auto n = words.size();
+  auto dst = words.data();
+  auto src = other.words.data();
+  for (size_t i = 0; i < n; i++)
+    dst[i] &= ~src[i];
+  return *this;
+}
+
+bool BitVector::operator==(const BitVector &other) const {
+  if (words.size() != other.words.size())
+    return false;
+  uint64_t diff = 0;
+  for (size_t i = 0; i < words.size(); i++)
+    diff |= words[i] ^ other.words[i];
+  return diff == 0;
+}
+
+bool BitVector::operator!=(const BitVector &other) const { return !(*this == other); }
+
+bool BitVector::unionWith(const BitVector &other) {
+  auto n = words.size();
+  auto dst = words.data();
+  auto src = other.words.data();
+  uint64_t changed = 0;
+  for (size_t i = 0; i < n; i++) {
+    changed |= src[i] & ~dst[i];
+    dst[i] |= src[i];
+  }
+  return changed != 0;
+}
+
+} // namespace L2
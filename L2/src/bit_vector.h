@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace L2 {
+
+/*
+ * Fixed-size packed bit set.
+ * Words are kept contiguous and padded to a multiple of 4 (256 bits), so the bulk operations are
+ * plain word loops without a scalar tail that the compiler can vectorize.
+ */
+class BitVector {
+public:
+  BitVector() = default;
+  BitVector(int64_t size);
+
+  int64_t size() const;
+  void resize(int64_t size);
+
+  bool test(int64_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+  void set(int64_t i) { words[i >> 6] |= (uint64_t)1 << (i & 63); }
+  void reset(int64_t i) { words[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+
+  void clear();
+  bool any() const;
+  int64_t count() const;
+
+  BitVector &operator|=(const BitVector &other);
+  BitVector &operator&=(const BitVector &other);
+  // set difference
+  BitVector &operator-=(const BitVector &other);
+  bool operator==(const BitVector &other) const;
+  bool operator!=(const BitVector &other) const;
+
+  /*
+   * Union other into this set.
+   * Returns true if any bit was newly set.
+   */
+  bool unionWith(const BitVector &other);
+
+  /*
+   * Call f(i) for every set bit i, in increasing order.
+   */
+  template <typename F> void forEach(F f) const {
+    for (int64_t w = 0; w < (int64_t)words.size(); w++) {
+      auto word = words[w];
+      while (word) {
+        f((w << 6) + __builtin_ctzll(word));
+        word &= word - 1;
+      }
+    }
+  }
+
+private:
+  int64_t numBits = 0;
+  std::vector<uint64_t> words;
+};
+
+} // namespace L2
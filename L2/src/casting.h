@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cassert>
+
+namespace L2 {
+
+/*
+ * LLVM style casts on the items and instructions, dispatching on their kind instead of RTTI.
+ * A class To can be the target of a cast if it has a static To::classof(const Base *) testing the
+ * kind of its argument.
+ */
+
+template <typename To, typename From> bool isa(const From *from) {
+  assert(from != nullptr && "isa<> used on a null pointer");
+  return To::classof(from);
+}
+
+/*
+ * Checked cast, from must be a To.
+ */
+template <typename To, typename From> const To *cast(const From *from) {
+  assert(isa<To>(from) && "cast<> argument of incompatible type");
+  return static_cast<const To *>(from);
+}
+
+/*
+ * Cast returning nullptr if from is not a To.
+ */
+template <typename To, typename From> const To *dyn_cast(const From *from) {
+  return from != nullptr && To::classof(from) ? static_cast<const To *>(from) : nullptr;
+}
+
+} // namespace L2
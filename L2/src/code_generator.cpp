@@ -56,8 +56,10 @@ public:
   }
 
   void visit(const StackLocation *stack) override {
+    // the stack arguments are above the spill slots, and above the return address if it was pushed
+    auto offset = stack->getOffset()->getVal() + spillInfo->getSpillCount() * 8;
     buffer += "mem rsp ";
-    buffer += to_string(stack->getOffset()->getVal() + spillInfo->getSpillCount() * 8);
+    buffer += to_string(nativeCalls ? offset + 8 : offset);
   }
 
   void visit(const FunctionName *name) override {
@@ -140,17 +142,15 @@ public:
   }
 
   void doVisit(const Instruction *I) {
+    // moves coalesced by the allocator are dropped
+    if (isEliminatedMove(I))
+      return;
+
     buffer = "";
     I->accept(*this);
     instructions.push_back(buffer);
   }
 
-  static L1CodeGenerator &getInstance() {
-    if (instance == nullptr)
-      instance = new L1CodeGenerator();
-    return *instance;
-  }
-
   const vector<string> &getInstructions() const { return instructions; }
 
   void loadFunctionInfo(const ColorResult &result) {
@@ -160,6 +160,21 @@ public:
   }
 
 private:
+  Register::ID getColor(const Symbol *sym) const {
+    if (auto reg = dyn_cast<Register>(sym))
+      return reg->getID();
+    return colorMap.at(sym);
+  }
+
+  bool isEliminatedMove(const Instruction *I) const {
+    auto assignInst = dyn_cast<AssignInst>(I);
+    if (assignInst == nullptr)
+      return false;
+    auto lval = dyn_cast<Symbol>(assignInst->getLval());
+    auto rval = dyn_cast<Symbol>(assignInst->getRval());
+    return lval != nullptr && rval != nullptr && getColor(lval) == getColor(rval);
+  }
+
   void printWithIndent(const string &str) { cout << indent << str << endl; }
 
   string buffer;
@@ -169,16 +184,8 @@ private:
   // info used for generating code
   ColorMap colorMap;
   const SpillInfo *spillInfo;
-
-  // singleton
-  L1CodeGenerator() = default;
-  L1CodeGenerator(const L1CodeGenerator &) = delete;
-  L1CodeGenerator &operator=(const L1CodeGenerator &) = delete;
-  static L1CodeGenerator *instance;
 };
 
-L1CodeGenerator *L1CodeGenerator::instance = nullptr;
-
 void generate_code(Program *P, unordered_map<const Function *, const ColorResult *> &results) {
 
   /*
@@ -187,7 +194,7 @@ void generate_code(Program *P, unordered_map<const Function *, const ColorResult
   ofstream outputFile;
   outputFile.open("prog.L1");
 
-  auto &generator = L1CodeGenerator::getInstance();
+  L1CodeGenerator generator;
 
   outputFile << "(" << P->getEntryPointLabel() << endl;
   for (auto F : P->getFunctions()) {
@@ -204,6 +211,9 @@ void generate_code(Program *P, unordered_map<const Function *, const ColorResult
       outputFile << "    " << I << endl;
 
     outputFile << "  )" << std::endl;
+
+    // nothing refers to the function once it has been written
+    F->release();
   }
   outputFile << ")" << endl;
   return;
@@ -9,6 +9,10 @@ using namespace std;
 
 namespace L2 {
 
+/*
+ * Write prog.L1. Each function is released after it has been written, with the results of its
+ * analyses.
+ */
 void generate_code(Program *P, unordered_map<const Function *, const ColorResult *> &results);
 
 }
@@ -1,22 +1,27 @@
 #include "dead_code_eliminator.h"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <stdint.h>
+#include <thread>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
 
 #include <L2.h>
 #include <code_generator.h>
 #include <graph_colorer.h>
 #include <interference_analyzer.h>
+#include <linear_scan.h>
 #include <liveness_analyzer.h>
 #include <parser.h>
 #include <spiller.h>
+#include <thread_pool.h>
 
 void printHelp(char *progName) {
-  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-s] [-l] [-i] [-d] SOURCE"
-            << std::endl;
+  std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-j THREADS] [-n] [-s] [-l]"
+            << " [-i] [-d] SOURCE" << std::endl;
   return;
 }
 
@@ -43,6 +48,7 @@ int main(int argc, char **argv) {
   auto interferenceOnly = false;
   auto livenessOnly = false;
   int32_t optLevel = 3;
+  int64_t threadNum = std::thread::hardware_concurrency();
 
   /*
    * Check the compiler arguments.
@@ -54,7 +60,7 @@ int main(int argc, char **argv) {
   }
   int32_t opt;
   int64_t functionNumber = -1;
-  while ((opt = getopt(argc, argv, "vg:O:slid")) != -1) {
+  while ((opt = getopt(argc, argv, "vg:O:j:nslid")) != -1) {
     switch (opt) {
 
     case 'l':
@@ -73,6 +79,14 @@ int main(int argc, char **argv) {
       optLevel = strtoul(optarg, NULL, 0);
       break;
 
+    case 'j':
+      threadNum = strtoul(optarg, NULL, 0);
+      break;
+
+    case 'n':
+      L2::nativeCalls = true;
+      break;
+
     case 'g':
       enableCodeGenerator = (strtoul(optarg, NULL, 0) == 0) ? false : true;
       break;
@@ -178,11 +192,28 @@ int main(int argc, char **argv) {
    * Generate the target code.
    */
   if (enableCodeGenerator) {
-    std::unordered_map<const L2::Function *, const L2::ColorResult *> colorResults;
-    for (auto F : P->getFunctions()) {
-      L2::eliminateDeadCode(F);
-      colorResults[F] = &L2::colorGraph(F);
+    // the functions are independent until the code generation, allocate them in parallel
+    auto &functions = P->getFunctions();
+    std::vector<const L2::ColorResult *> results(functions.size());
+    {
+      L2::ThreadPool pool(std::max<int64_t>(threadNum, 1));
+      for (size_t i = 0; i < functions.size(); i++)
+        pool.submit([&, i]() {
+          auto F = functions[i];
+          auto &livenessResult = L2::eliminateDeadCode(F);
+          // linear scan at -O0 / -O1, splitting the live ranges at calls at -O1
+          if (optLevel <= 1)
+            results[i] = &L2::allocateLinearScan(F, livenessResult, optLevel == 1);
+          else
+            results[i] = &L2::colorGraph(F, livenessResult);
+          F->getArena().destroy(&livenessResult);
+        });
+      pool.wait();
     }
+
+    std::unordered_map<const L2::Function *, const L2::ColorResult *> colorResults;
+    for (size_t i = 0; i < functions.size(); i++)
+      colorResults[functions[i]] = results[i];
     L2::generate_code(P, colorResults);
   }
 
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <L2.h>
+#include <dataflow.h>
+
+namespace L2 {
+
+BlockGraph::BlockGraph(const Function *F) {
+  for (auto BB : F->getBasicBlocks()) {
+    indices[BB] = blocks.size();
+    blocks.push_back(BB);
+  }
+
+  successors.resize(blocks.size());
+  predecessors.resize(blocks.size());
+  for (int64_t b = 0; b < (int64_t)blocks.size(); b++) {
+    for (auto succ : blocks[b]->getSuccessors())
+      successors[b].push_back(indices.at(succ));
+    for (auto pred : blocks[b]->getPredecessors())
+      predecessors[b].push_back(indices.at(pred));
+    // the edges are kept in hash sets, sort them to make the iteration order stable
+    std::sort(successors[b].begin(), successors[b].end());
+    std::sort(predecessors[b].begin(), predecessors[b].end());
+  }
+}
+
+int64_t BlockGraph::size() const { return blocks.size(); }
+int64_t BlockGraph::getIndex(const BasicBlock *BB) const { return indices.at(BB); }
+const BasicBlock *BlockGraph::getBlock(int64_t b) const { return blocks[b]; }
+const std::vector<int64_t> &BlockGraph::getSuccessors(int64_t b) const { return successors[b]; }
+const std::vector<int64_t> &BlockGraph::getPredecessors(int64_t b) const {
+  return predecessors[b];
+}
+
+std::vector<int64_t> BlockGraph::getReversePostorder(Direction dir) const {
+  auto n = (int64_t)blocks.size();
+  auto &edges = dir == Direction::FORWARD ? successors : predecessors;
+  auto &reverseEdges = dir == Direction::FORWARD ? predecessors : successors;
+
+  std::vector<int64_t> postorder;
+  std::vector<bool> visited(n, false);
+  // iterative DFS, each frame is a block and the index of the next edge to follow
+  std::vector<std::pair<int64_t, size_t>> stack;
+  auto dfs = [&](int64_t root) {
+    if (visited[root])
+      return;
+    visited[root] = true;
+    stack.push_back({root, 0});
+    while (!stack.empty()) {
+      auto &[b, next] = stack.back();
+      if (next < edges[b].size()) {
+        auto target = edges[b][next++];
+        if (!visited[target]) {
+          visited[target] = true;
+          stack.push_back({target, 0});
+        }
+        continue;
+      }
+      postorder.push_back(b);
+      stack.pop_back();
+    }
+  };
+
+  // roots: the entry block for forward problems, the exits for backward ones
+  if (dir == Direction::FORWARD) {
+    if (n > 0)
+      dfs(0);
+  } else {
+    for (int64_t b = 0; b < n; b++)
+      if (reverseEdges[b].empty())
+        dfs(b);
+  }
+  // blocks not reachable from the roots
+  for (int64_t b = n - 1; b >= 0; b--)
+    dfs(b);
+
+  std::reverse(postorder.begin(), postorder.end());
+  return postorder;
+}
+
+} // namespace L2
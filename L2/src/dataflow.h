@@ -0,0 +1,146 @@
+#pragma once
+
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <L2.h>
+#include <bit_vector.h>
+
+namespace L2 {
+
+enum class Direction { FORWARD, BACKWARD };
+
+/*
+ * Index based view of the CFG of a function.
+ * Blocks are numbered by their position in Function::getBasicBlocks().
+ */
+class BlockGraph {
+public:
+  BlockGraph(const Function *F);
+  int64_t size() const;
+  int64_t getIndex(const BasicBlock *BB) const;
+  const BasicBlock *getBlock(int64_t b) const;
+  const std::vector<int64_t> &getSuccessors(int64_t b) const;
+  const std::vector<int64_t> &getPredecessors(int64_t b) const;
+
+  /*
+   * Reverse postorder of the CFG in the given direction.
+   * For BACKWARD, the DFS walks predecessor edges starting from the exit blocks, blocks that can
+   * not reach an exit (infinite loops) are used as extra roots.
+   */
+  std::vector<int64_t> getReversePostorder(Direction dir) const;
+
+private:
+  std::vector<const BasicBlock *> blocks;
+  std::unordered_map<const BasicBlock *, int64_t> indices;
+  std::vector<std::vector<int64_t>> successors, predecessors;
+};
+
+/*
+ * Meet operators.
+ */
+struct UnionMeet {
+  static void top(BitVector &value) { value.clear(); }
+  static void meet(BitVector &value, const BitVector &other) { value |= other; }
+};
+
+struct IntersectMeet {
+  static void top(BitVector &value) {
+    value.clear();
+    for (int64_t i = 0; i < value.size(); i++)
+      value.set(i);
+  }
+  static void meet(BitVector &value, const BitVector &other) { value &= other; }
+};
+
+/*
+ * Iterative dataflow solver over bit vectors.
+ *
+ * Transfer is called as transfer(b, input, output): input is the meet over the neighbors of
+ * block b (its OUT set for BACKWARD problems, its IN set for FORWARD ones) and output must be
+ * set to the value on the other side of the block.
+ *
+ * Blocks are scheduled in reverse postorder of the CFG in the direction of the problem, and a
+ * block is never queued twice.
+ */
+template <Direction dir, typename Meet, typename Transfer> class DataflowSolver {
+public:
+  DataflowSolver(const BlockGraph &graph, int64_t size, Transfer &transfer)
+      : graph{graph}, transfer{transfer}, IN(graph.size(), BitVector(size)),
+        OUT(graph.size(), BitVector(size)) {
+    for (int64_t b = 0; b < graph.size(); b++) {
+      Meet::top(IN[b]);
+      Meet::top(OUT[b]);
+    }
+  }
+
+  void solve() {
+    auto n = graph.size();
+    auto order = graph.getReversePostorder(dir);
+    std::vector<int64_t> priority(n);
+    for (int64_t i = 0; i < n; i++)
+      priority[order[i]] = i;
+
+    // min-heap on the position in the order
+    std::priority_queue<std::pair<int64_t, int64_t>, std::vector<std::pair<int64_t, int64_t>>,
+                        std::greater<std::pair<int64_t, int64_t>>>
+        workq;
+    std::vector<bool> inQueue(n, true), visited(n, false);
+    for (auto b : order)
+      workq.push({priority[b], b});
+
+    BitVector output;
+    while (!workq.empty()) {
+      auto b = workq.top().second;
+      workq.pop();
+      inQueue[b] = false;
+
+      auto backward = dir == Direction::BACKWARD;
+      auto &meetFrom = backward ? graph.getSuccessors(b) : graph.getPredecessors(b);
+      auto &input = backward ? OUT[b] : IN[b];
+      auto &blockOutput = backward ? IN[b] : OUT[b];
+
+      // boundary blocks keep the value they have been initialized with
+      if (!meetFrom.empty()) {
+        Meet::top(input);
+        for (auto other : meetFrom)
+          Meet::meet(input, backward ? IN[other] : OUT[other]);
+      }
+
+      output = blockOutput;
+      transfer(b, (const BitVector &)input, output);
+      if (visited[b] && output == blockOutput)
+        continue;
+      std::swap(blockOutput, output);
+      visited[b] = true;
+
+      for (auto other : backward ? graph.getPredecessors(b) : graph.getSuccessors(b)) {
+        if (inQueue[other])
+          continue;
+        inQueue[other] = true;
+        workq.push({priority[other], other});
+      }
+    }
+  }
+
+  /*
+   * Initial value of the boundary blocks (exits for BACKWARD, the entry for FORWARD), and of
+   * the blocks before their first visit.
+   */
+  void setBoundary(int64_t b, const BitVector &value) {
+    (dir == Direction::BACKWARD ? OUT[b] : IN[b]) = value;
+  }
+
+  std::vector<BitVector> &getIN() { return IN; }
+  std::vector<BitVector> &getOUT() { return OUT; }
+
+private:
+  const BlockGraph &graph;
+  Transfer &transfer;
+  std::vector<BitVector> IN, OUT;
+};
+
+} // namespace L2
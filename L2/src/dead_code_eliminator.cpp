@@ -1,119 +1,105 @@
-#include <unordered_set>
 #include <vector>
 
 #include <L2.h>
+#include <bit_vector.h>
+#include <dataflow.h>
 #include <dead_code_eliminator.h>
+#include <instruction_stream.h>
 #include <liveness_analyzer.h>
 
 using namespace std;
 
 namespace L2 {
 
-class DeadCodeEliminator : Visitor {
+/*
+ * Faint variable elimination.
+ * An instruction defining a register or a variable without any other effect is dead if the
+ * defined symbol is not live after it, where the uses of dead instructions do not count (strong
+ * liveness). Strong liveness is solved once over the blocks, so whole chains of dead definitions
+ * are removed in a single pass.
+ */
+class DeadCodeEliminator {
 public:
-  void visit(const Register *reg) {
-    if (reg->getID() == Register::ID::RSP)
-      return;
-    if (OUT->find(reg) == OUT->end())
-      eliminated = true;
+  DeadCodeEliminator(Function *F, LivenessResult &liveness)
+      : F{F}, liveness{liveness}, stream{liveness.getStream()}, graph{liveness.getBlockGraph()} {}
+
+  /*
+   * Transfer function of the strong liveness problem.
+   */
+  void operator()(int64_t b, const BitVector &OUT, BitVector &IN) {
+    IN = OUT;
+    scanBlock(b, IN, nullptr);
   }
 
-  void visit(const Variable *var) {
-    if (OUT->find(var) == OUT->end())
-      eliminated = true;
-  }
-
-  void visit(const Number *num) {}
-  void visit(const CompareOp *op) {}
-  void visit(const ShiftOp *op) {}
-  void visit(const ArithOp *op) {}
-  void visit(const SelfModOp *op) {}
-  void visit(const MemoryLocation *mem) {}
-  void visit(const StackLocation *stack) {}
-  void visit(const FunctionName *name) {}
-  void visit(const Label *label) {}
-
-  void visit(const RetInst *inst) {}
-
-  void visit(const ShiftInst *inst) { inst->getLval()->accept(*this); }
-
-  void visit(const ArithInst *inst) { inst->getLval()->accept(*this); }
-
-  void visit(const SelfModInst *inst) { inst->getLval()->accept(*this); }
-
-  void visit(const AssignInst *inst) {
-    if (inst->getLval() == inst->getRval()) {
-      eliminated = true;
-      return;
+  /*
+   * Remove the dead instructions and patch the liveness result.
+   * Returns true if any instruction has been removed.
+   */
+  bool eliminate() {
+    DataflowSolver<Direction::BACKWARD, UnionMeet, DeadCodeEliminator> solver(
+        graph, liveness.getSymbolTable().size(), *this);
+    solver.solve();
+
+    bool changed = false;
+    vector<bool> dead;
+    for (int64_t b = 0; b < graph.size(); b++) {
+      BitVector live = solver.getOUT()[b];
+      dead.assign(graph.getBlock(b)->getInstructions().size(), false);
+      if (!scanBlock(b, live, &dead))
+        continue;
+
+      auto BB = F->getBasicBlocks()[b];
+      vector<const Instruction *> liveInsts;
+      for (size_t i = 0; i < dead.size(); i++)
+        if (!dead[i])
+          liveInsts.push_back(BB->instructions[i]);
+      BB->instructions = liveInsts;
+      changed = true;
     }
 
-    inst->getLval()->accept(*this);
-  }
-
-  void visit(const CompareAssignInst *inst) { inst->getLval()->accept(*this); }
-
-  void visit(const CallInst *inst) {}
-  void visit(const PrintInst *inst) {}
-  void visit(const InputInst *inst) {}
-  void visit(const AllocateInst *inst) {}
-  void visit(const TupleErrorInst *inst) {}
-  void visit(const TensorErrorInst *inst) {}
-
-  void visit(const SetInst *inst) { inst->getLval()->accept(*this); }
-
-  void visit(const LabelInst *inst) {}
-  void visit(const GotoInst *inst) {}
-  void visit(const CondJumpInst *inst) {}
-
-  bool visitBB(BasicBlock *BB) {
-    changed = false;
-    liveInsts.clear();
-    for (auto inst : BB->getInstructions())
-      visitInst(inst);
+    // without the dead instructions, strong liveness is plain liveness
+    if (changed)
+      liveness.updateAfterElimination(std::move(solver.getIN()), std::move(solver.getOUT()));
     return changed;
   }
 
-  void visitInst(const Instruction *inst) {
-    eliminated = false;
-    OUT = &liveness.getLivenessSets(inst).getOUT();
-    inst->accept(*this);
-    changed |= eliminated;
-    if (!eliminated)
-      liveInsts.push_back(inst);
-  }
-
-  vector<const Instruction *> &getLiveInsts() { return liveInsts; }
-
-  DeadCodeEliminator(const LivenessResult &liveness) : liveness(liveness) {}
-
 private:
-  vector<const Instruction *> liveInsts;
-
-  const unordered_set<const Symbol *> *OUT;
-  const LivenessResult &liveness;
-  bool changed, eliminated;
+  Function *F;
+  LivenessResult &liveness;
+  const InstructionStream &stream;
+  const BlockGraph &graph;
+
+  /*
+   * Walk block b backward, live holding its OUT set and updated to its IN set.
+   * The dead instructions are marked in dead if given. Returns true if any instruction is dead.
+   */
+  bool scanBlock(int64_t b, BitVector &live, vector<bool> *dead) {
+    auto first = stream.getBlockStart(b);
+    bool found = false;
+    liveness.scanBlockGenKill(
+        graph.getBlock(b), [&](int64_t i, const IDList &GEN, const IDList &KILL) {
+          // only the instructions whose single effect is to define a symbol can be removed
+          auto def = stream.getPureDef(i);
+          if (stream.isSelfMove(i) || (def >= 0 && !live.test(def))) {
+            if (dead)
+              (*dead)[i - first] = true;
+            found = true;
+            return;
+          }
+          for (auto id : KILL)
+            live.reset(id);
+          for (auto id : GEN)
+            live.set(id);
+        });
+    return found;
+  }
 };
 
-bool doElimination(Function *F) {
-  bool changed = false;
+LivenessResult &eliminateDeadCode(Function *F) {
   auto &liveness = analyzeLiveness(F);
-  DeadCodeEliminator eliminator(liveness);
-  for (auto BB : F->getBasicBlocks()) {
-    bool bbChanged = eliminator.visitBB(BB);
-    changed |= bbChanged;
-
-    if (!bbChanged)
-      continue;
-
-    auto &liveInsts = eliminator.getLiveInsts();
-    BB->instructions = liveInsts;
-  }
-  return changed;
-}
-
-void eliminateDeadCode(Function *F) {
-  while (doElimination(F)) {
-  }
+  DeadCodeEliminator eliminator(F, liveness);
+  eliminator.eliminate();
+  return liveness;
 }
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
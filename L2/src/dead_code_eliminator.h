@@ -1,7 +1,13 @@
 #pragma once
 
 #include <L2.h>
+#include <liveness_analyzer.h>
 
 namespace L2 {
-void eliminateDeadCode(Function *F);
-}
\ No newline at end of file
+
+/*
+ * Remove the dead instructions of F.
+ * Returns the liveness of the function after the elimination.
+ */
+LivenessResult &eliminateDeadCode(Function *F);
+} // namespace L2
@@ -1,13 +1,23 @@
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <queue>
 #include <stdexcept>
+#include <utility>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <L2.h>
 #include <graph_colorer.h>
+#include <helper.h>
+#include <instruction_stream.h>
 #include <interference_analyzer.h>
+#include <live_range_splitter.h>
 #include <liveness_analyzer.h>
+#include <loop_analyzer.h>
 #include <spiller.h>
 
 namespace L2 {
@@ -24,34 +34,35 @@ std::string findSpillPrefix(Function *F) {
   return longest + "_spill";
 }
 
-typedef struct Node {
-  const Variable *var;
-  int degree;
-} Node;
-
-bool inGraph(const std::unordered_set<const Variable *> &removed, const Symbol *sym) {
-  if (auto var = dynamic_cast<const Variable *>(sym))
-    return removed.find(var) == removed.end();
-  return true;
-}
-
-int getDegree(const std::unordered_set<const Variable *> &removed,
-              const std::unordered_set<const Symbol *> &neighbors) {
-  int count = 0;
-
-  for (auto nbr : neighbors)
-    if (inGraph(removed, nbr))
-      count++;
-
+int64_t countEliminatedMoves(const Function *F, const ColorMap &colorMap) {
+  int64_t count = 0;
+  for (auto BB : F->getBasicBlocks())
+    for (auto I : BB->getInstructions()) {
+      auto assignInst = dyn_cast<AssignInst>(I);
+      if (assignInst == nullptr)
+        continue;
+      auto lval = dyn_cast<Symbol>(assignInst->getLval());
+      auto rval = dyn_cast<Symbol>(assignInst->getRval());
+      if (lval == nullptr || rval == nullptr || lval == rval)
+        continue;
+      auto dst = colorMap.find(lval), src = colorMap.find(rval);
+      if (dst != colorMap.end() && src != colorMap.end() && dst->second == src->second)
+        count++;
+    }
   return count;
 }
 
 const ColorMap &ColorResult::getColorMap() const { return colorMap; }
 const SpillInfo &ColorResult::getSpillInfo() const { return *spillInfo; }
+int64_t ColorResult::getMovesEliminated() const { return movesEliminated; }
 void ColorResult::dump() const {
   std::cout << "color map:" << std::endl;
   for (auto &[sym, color] : colorMap)
     std::cout << sym->toStr() << " " << Register::getRegister(color)->toStr() << std::endl;
+  std::cout << "moves eliminated: " << movesEliminated << std::endl;
+  std::cout << "spill costs:" << std::endl;
+  for (auto &[var, cost] : spillCosts)
+    std::cout << var->toStr() << " " << cost << std::endl;
   spillInfo->dump();
 }
 
@@ -60,122 +71,580 @@ const static auto colorPriority = {
     Register::ID::R10, Register::ID::R11, Register::ID::R8,  Register::ID::R9,  Register::ID::RAX,
     Register::ID::RCX, Register::ID::RDI, Register::ID::RDX, Register::ID::RSI, Register::ID::R12,
     Register::ID::R13, Register::ID::R14, Register::ID::R15, Register::ID::RBP, Register::ID::RBX};
+// variables live across a call can not take a caller saved register
+const static auto callCrossingPriority = {
+    Register::ID::R12, Register::ID::R13, Register::ID::R14, Register::ID::R15, Register::ID::RBP,
+    Register::ID::RBX, Register::ID::R10, Register::ID::R11, Register::ID::R8,  Register::ID::R9,
+    Register::ID::RAX, Register::ID::RCX, Register::ID::RDI, Register::ID::RDX, Register::ID::RSI};
 
 /*
- * Try to color the graph.
- * This function will update the result passed in.
+ * A copy between two numbered symbols, dst <- src.
  */
-bool tryColor(Function *F, ColorResult &result) {
-  auto &livenessResult = analyzeLiveness(F);
-  auto &interferenceResult = analyzeInterference(F, livenessResult);
-  auto &graph = interferenceResult.getGraph();
+struct Move {
+  int64_t dst, src;
+};
 
-  auto &spillInfo = *result.spillInfo;
-  auto &colorMap = result.colorMap;
-  colorMap.clear();
-  // stack
-  std::vector<const Variable *> stack;
-  std::unordered_set<const Variable *> removed;
+std::vector<Move> collectMoves(const InstructionStream &stream) {
+  std::vector<Move> moves;
+  for (int64_t i = 0; i < stream.size(); i++) {
+    // rsp is never numbered
+    auto dst = stream.getPureDef(i), src = stream.getMoveSource(i);
+    if (dst >= 0 && src >= 0 && dst != src)
+      moves.push_back({dst, src});
+  }
+  return moves;
+}
 
-  colorMap.clear();
-  for (auto reg : Register::getAllGPRegisters())
-    colorMap[reg] = reg->getID();
+/*
+ * Number of uses and definitions of each symbol, weighted by 10 to the loop depth of the block
+ * they are in. The variables introduced by spilling can not be spilled again and weigh infinity.
+ */
+std::vector<double> computeWeights(const LivenessResult &livenessResult,
+                                   const SpillInfo &spillInfo) {
+  auto &symbols = livenessResult.getSymbolTable();
+  auto &blockGraph = livenessResult.getBlockGraph();
+  LoopResult loops(blockGraph);
 
-  // remove nodes with edges < K
-  bool stop;
+  std::vector<double> weights(symbols.size(), 0);
+  for (int64_t b = 0; b < blockGraph.size(); b++) {
+    auto weight = loops.getFrequency(b);
+    livenessResult.scanBlockLive(
+        blockGraph.getBlock(b),
+        [&](int64_t i, const BitVector &live, const IDList &GEN, const IDList &KILL) {
+          for (auto id : GEN)
+            weights[id] += weight;
+          for (auto id : KILL)
+            weights[id] += weight;
+        });
+  }
 
-  do {
-    stop = true;
-    for (auto &[sym, neighbors] : graph) {
-      if (!dynamic_cast<const Variable *>(sym))
-        continue;
-      if (!inGraph(removed, sym))
+  for (int64_t id = 0; id < symbols.size(); id++)
+    if (!symbols.isRegister(id) && spillInfo.isSpilled((const Variable *)symbols.getSymbol(id)))
+      weights[id] = INFINITY;
+  return weights;
+}
+
+/*
+ * Find the variables live across a call, print, input or allocate.
+ */
+std::vector<bool> findCallCrossing(const LivenessResult &livenessResult) {
+  auto &symbols = livenessResult.getSymbolTable();
+  auto &blockGraph = livenessResult.getBlockGraph();
+  auto &stream = livenessResult.getStream();
+  std::vector<bool> crossing(symbols.size(), false);
+  for (int64_t b = 0; b < blockGraph.size(); b++)
+    livenessResult.scanBlockLive(
+        blockGraph.getBlock(b),
+        [&](int64_t i, const BitVector &live, const IDList &GEN, const IDList &KILL) {
+          if (stream.isCall(i))
+            live.forEach([&](int64_t id) { crossing[id] = true; });
+        });
+  return crossing;
+}
+
+/*
+ * Iterated register coalescing (George and Appel) on one interference graph.
+ *
+ * Degrees are maintained incrementally: non move related nodes of low degree wait in the simplify
+ * worklist, move related ones in the freeze worklist and the others in the spill worklist. Moves
+ * are coalesced conservatively, with the George test when one end is a register and the Briggs
+ * test otherwise. When nothing can be simplified or coalesced, the moves of a low degree node are
+ * frozen, and when only high degree nodes are left, the one of lowest spill cost is removed
+ * optimistically and only becomes an actual spill if no color is left for it in the select phase.
+ *
+ * The spill cost of a node is its weight (uses and definitions weighted by loop depth) divided by
+ * its current degree.
+ *
+ * In the select phase a node first tries the colors of the nodes it is still related to by a
+ * move, then the callee saved registers if it lives across a call, the caller saved ones
+ * otherwise.
+ */
+class GraphColorer {
+public:
+  GraphColorer(const InterferenceGraph &graph, const SymbolTable &symbols,
+               const std::vector<Move> &moves, const std::vector<double> &weights,
+               const std::vector<bool> &crossesCall)
+      : graph{graph}, symbols{symbols}, moves{moves}, n{graph.size()}, degree(n), colors(n, -1),
+        alias(n), marks(n, 0), weights{weights}, costs(n, 0), states(n, NodeState::INITIAL),
+        crossesCall{crossesCall}, moveStates(moves.size()), moveList(n) {}
+
+  void color() {
+    makeWorklists();
+    while (true) {
+      if (!simplifyWorklist.empty())
+        simplify();
+      else if (!worklistMoves.empty())
+        coalesce();
+      else if (!freezeWorklist.empty())
+        freeze();
+      else if (!spillWorklist.empty())
+        selectSpill();
+      else
+        break;
+    }
+    assignColors();
+  }
+
+  /*
+   * Color of each node, -1 if the node could not be colored.
+   * Coalesced nodes take the color of the node they have been merged into.
+   */
+  const std::vector<int64_t> &getColors() const { return colors; }
+
+  /*
+   * Nodes left without a color in the select phase, not including the coalesced ones.
+   */
+  const std::vector<int64_t> &getSpilledNodes() const { return spilledNodes; }
+
+  /*
+   * Spill cost of a node when it was picked for spilling.
+   */
+  double getSpillCost(int64_t id) const { return costs[id]; }
+
+private:
+  enum class NodeState { PRECOLORED, INITIAL, SIMPLIFY, FREEZE, SPILL, COALESCED, STACK, COLORED };
+  enum class MoveState { WORKLIST, ACTIVE, COALESCED, CONSTRAINED, FROZEN };
+
+  // degree of the registers, which are never simplified
+  const static int64_t infiniteDegree = INT64_MAX / 2;
+
+  // coalescing adds edges, so the graph is copied
+  InterferenceGraph graph;
+  const SymbolTable &symbols;
+  const std::vector<Move> &moves;
+  int64_t n;
+  std::vector<int64_t> degree, colors, alias, marks;
+  int64_t markEpoch = 0;
+  std::vector<double> weights, costs;
+  std::vector<NodeState> states;
+  std::vector<bool> crossesCall;
+  std::vector<MoveState> moveStates;
+  std::vector<std::vector<int64_t>> moveList;
+
+  // the worklists may hold stale entries, which are skipped by checking the state when popped
+  std::vector<int64_t> simplifyWorklist, freezeWorklist, worklistMoves, selectStack, spilledNodes;
+  // min-heap on (cost, node). A node whose degree decreases gets more expensive, its entry is
+  // refreshed when popped. Coalescing can make a node cheaper, it is then pushed again and the
+  // entries left behind are refreshed or skipped when popped
+  std::priority_queue<std::pair<double, int64_t>, std::vector<std::pair<double, int64_t>>,
+                      std::greater<std::pair<double, int64_t>>>
+      spillWorklist;
+
+  bool isPrecolored(int64_t id) const { return states[id] == NodeState::PRECOLORED; }
+
+  bool isRemoved(int64_t id) const {
+    return states[id] == NodeState::STACK || states[id] == NodeState::COALESCED;
+  }
+
+  template <typename F> void forEachAdjacent(int64_t id, F f) const {
+    for (auto nbr : graph.getNeighbors(id))
+      if (!isRemoved(nbr))
+        f(nbr);
+  }
+
+  template <typename F> void forEachNodeMove(int64_t id, F f) const {
+    for (auto m : moveList[id])
+      if (moveStates[m] == MoveState::WORKLIST || moveStates[m] == MoveState::ACTIVE)
+        f(m);
+  }
+
+  bool isMoveRelated(int64_t id) const {
+    for (auto m : moveList[id])
+      if (moveStates[m] == MoveState::WORKLIST || moveStates[m] == MoveState::ACTIVE)
+        return true;
+    return false;
+  }
+
+  int64_t getAlias(int64_t id) const {
+    while (states[id] == NodeState::COALESCED)
+      id = alias[id];
+    return id;
+  }
+
+  void makeWorklists() {
+    for (int64_t m = 0; m < (int64_t)moves.size(); m++) {
+      moveList[moves[m].dst].push_back(m);
+      moveList[moves[m].src].push_back(m);
+      moveStates[m] = MoveState::WORKLIST;
+      worklistMoves.push_back(m);
+    }
+    // coalesce in program order
+    std::reverse(worklistMoves.begin(), worklistMoves.end());
+
+    for (int64_t id = 0; id < n; id++) {
+      alias[id] = id;
+      if (symbols.isRegister(id)) {
+        // registers are precolored and never removed
+        states[id] = NodeState::PRECOLORED;
+        degree[id] = infiniteDegree;
+        colors[id] = id;
         continue;
-      auto var = dynamic_cast<const Variable *>(sym);
-      if (getDegree(removed, neighbors) < K) {
-        stop = false;
-        stack.push_back(var);
-        removed.insert(var);
       }
+
+      degree[id] = graph.getDegree(id);
+      if (degree[id] >= K)
+        pushSpill(id);
+      else if (isMoveRelated(id))
+        pushFreeze(id);
+      else
+        pushSimplify(id);
     }
-  } while (!stop);
+  }
 
-  // remove other nodes
-  std::vector<Node> nodes;
-  for (auto &[sym, neighbors] : graph) {
-    if (!inGraph(removed, sym))
-      continue;
-    // don't care about registers, we do not color them
-    if (auto var = dynamic_cast<const Variable *>(sym))
-      nodes.push_back({var, getDegree(removed, neighbors)});
-  }
-  std::sort(nodes.begin(), nodes.end(),
-            [](const Node &a, const Node &b) { return a.degree > b.degree; });
-  for (auto &node : nodes) {
-    stack.push_back(node.var);
-    removed.insert(node.var);
-  }
-
-  while (!stack.empty()) {
-    // pop a node from the stack
-    auto var = stack.back();
-    stack.pop_back();
-    removed.erase(var);
-
-    // assign a color for it if possible
-    for (auto color : colorPriority) {
-      bool legal = true;
-      for (auto nbr : interferenceResult.getNeighbors(var)) {
-        if (colorMap.find(nbr) != colorMap.end() && colorMap.at(nbr) == color) {
-          legal = false;
-          break;
-        }
+  void pushSimplify(int64_t id) {
+    states[id] = NodeState::SIMPLIFY;
+    simplifyWorklist.push_back(id);
+  }
+
+  void pushFreeze(int64_t id) {
+    states[id] = NodeState::FREEZE;
+    freezeWorklist.push_back(id);
+  }
+
+  void pushSpill(int64_t id) {
+    states[id] = NodeState::SPILL;
+    spillWorklist.push({getCost(id), id});
+  }
+
+  double getCost(int64_t id) const { return weights[id] / degree[id]; }
+
+  void addEdge(int64_t a, int64_t b) {
+    if (a == b || graph.interferes(a, b))
+      return;
+    graph.addEdge(a, b);
+    if (!isPrecolored(a))
+      degree[a]++;
+    if (!isPrecolored(b))
+      degree[b]++;
+  }
+
+  void enableMoves(int64_t id) {
+    forEachNodeMove(id, [&](int64_t m) {
+      if (moveStates[m] == MoveState::ACTIVE) {
+        moveStates[m] = MoveState::WORKLIST;
+        worklistMoves.push_back(m);
       }
-      if (legal) {
-        colorMap[var] = color;
-        break;
+    });
+  }
+
+  void decrementDegree(int64_t id) {
+    if (isPrecolored(id))
+      return;
+    if (degree[id]-- != K || states[id] != NodeState::SPILL)
+      return;
+
+    enableMoves(id);
+    forEachAdjacent(id, [&](int64_t nbr) { enableMoves(nbr); });
+    if (isMoveRelated(id))
+      pushFreeze(id);
+    else
+      pushSimplify(id);
+  }
+
+  void simplify() {
+    auto id = simplifyWorklist.back();
+    simplifyWorklist.pop_back();
+    if (states[id] != NodeState::SIMPLIFY)
+      return;
+
+    states[id] = NodeState::STACK;
+    selectStack.push_back(id);
+    forEachAdjacent(id, [&](int64_t nbr) { decrementDegree(nbr); });
+  }
+
+  void addWorklist(int64_t id) {
+    if (states[id] == NodeState::FREEZE && !isMoveRelated(id) && degree[id] < K)
+      pushSimplify(id);
+  }
+
+  /*
+   * George test: every neighbor t of the node merged into the register r is either of low
+   * degree, a register, or already interferes with r.
+   */
+  bool isGeorgeSafe(int64_t t, int64_t r) const {
+    return degree[t] < K || isPrecolored(t) || graph.interferes(t, r);
+  }
+
+  /*
+   * Briggs test: the merged node has less than K neighbors of significant degree.
+   */
+  bool isBriggsSafe(int64_t u, int64_t v) {
+    markEpoch++;
+    int64_t significant = 0;
+    auto count = [&](int64_t t) {
+      if (marks[t] == markEpoch)
+        return;
+      marks[t] = markEpoch;
+      if (degree[t] >= K)
+        significant++;
+    };
+    forEachAdjacent(u, count);
+    forEachAdjacent(v, count);
+    return significant < K;
+  }
+
+  void coalesce() {
+    auto m = worklistMoves.back();
+    worklistMoves.pop_back();
+    if (moveStates[m] != MoveState::WORKLIST)
+      return;
+
+    auto u = getAlias(moves[m].dst), v = getAlias(moves[m].src);
+    if (isPrecolored(v))
+      std::swap(u, v);
+
+    if (u == v) {
+      moveStates[m] = MoveState::COALESCED;
+      addWorklist(u);
+      return;
+    }
+
+    if (isPrecolored(v) || graph.interferes(u, v)) {
+      moveStates[m] = MoveState::CONSTRAINED;
+      addWorklist(u);
+      addWorklist(v);
+      return;
+    }
+
+    bool safe;
+    if (isPrecolored(u)) {
+      safe = true;
+      forEachAdjacent(v, [&](int64_t t) { safe = safe && isGeorgeSafe(t, u); });
+    } else
+      safe = isBriggsSafe(u, v);
+
+    if (!safe) {
+      moveStates[m] = MoveState::ACTIVE;
+      return;
+    }
+
+    moveStates[m] = MoveState::COALESCED;
+    combine(u, v);
+    addWorklist(u);
+  }
+
+  void combine(int64_t u, int64_t v) {
+    states[v] = NodeState::COALESCED;
+    alias[v] = u;
+    weights[u] += weights[v];
+    crossesCall[u] = crossesCall[u] || crossesCall[v];
+    for (auto m : moveList[v])
+      moveList[u].push_back(m);
+    enableMoves(v);
+
+    forEachAdjacent(v, [&](int64_t t) {
+      addEdge(t, u);
+      decrementDegree(t);
+    });
+
+    // the weight and the degree of u have grown, its cost may be lower than its heap entry
+    if ((degree[u] >= K && states[u] == NodeState::FREEZE) || states[u] == NodeState::SPILL)
+      pushSpill(u);
+  }
+
+  void freeze() {
+    auto id = freezeWorklist.back();
+    freezeWorklist.pop_back();
+    if (states[id] != NodeState::FREEZE)
+      return;
+
+    pushSimplify(id);
+    freezeMoves(id);
+  }
+
+  void freezeMoves(int64_t u) {
+    forEachNodeMove(u, [&](int64_t m) {
+      auto x = getAlias(moves[m].dst), y = getAlias(moves[m].src);
+      auto v = y == getAlias(u) ? x : y;
+      moveStates[m] = MoveState::FROZEN;
+      if (states[v] == NodeState::FREEZE && !isMoveRelated(v) && degree[v] < K)
+        pushSimplify(v);
+    });
+  }
+
+  void selectSpill() {
+    auto [cost, id] = spillWorklist.top();
+    spillWorklist.pop();
+    if (states[id] != NodeState::SPILL)
+      return;
+    if (cost != getCost(id)) {
+      spillWorklist.push({getCost(id), id});
+      return;
+    }
+
+    // remove the cheapest node optimistically
+    costs[id] = cost;
+    pushSimplify(id);
+    freezeMoves(id);
+  }
+
+  int64_t pickColor(int64_t id, uint32_t used) const {
+    // the color of a move partner makes the move disappear
+    for (auto m : moveList[id]) {
+      auto x = getAlias(moves[m].dst), y = getAlias(moves[m].src);
+      auto color = colors[x == id ? y : x];
+      if (color >= 0 && !(used & (1u << color)))
+        return color;
+    }
+
+    for (auto color : crossesCall[id] ? callCrossingPriority : colorPriority)
+      if (!(used & (1u << color)))
+        return color;
+    return -1;
+  }
+
+  void assignColors() {
+    while (!selectStack.empty()) {
+      auto id = selectStack.back();
+      selectStack.pop_back();
+
+      uint32_t used = 0;
+      for (auto nbr : graph.getNeighbors(id)) {
+        auto color = colors[getAlias(nbr)];
+        if (color >= 0)
+          used |= 1u << color;
       }
+
+      colors[id] = pickColor(id, used);
+      if (colors[id] >= 0)
+        states[id] = NodeState::COLORED;
+      else
+        spilledNodes.push_back(id);
     }
+
+    for (int64_t id = 0; id < n; id++)
+      if (states[id] == NodeState::COALESCED)
+        colors[id] = colors[getAlias(id)];
   }
+};
+
+/*
+ * Try to color the graph.
+ * This function will update the result passed in. On failure live ranges are split or the
+ * function is rewritten by the spiller, and both analysis results are updated for the next
+ * round, the interference result being replaced after a split.
+ */
+bool tryColor(Function *F, LivenessResult &livenessResult, InterferenceResult *&interferenceResult,
+              ColorResult &result) {
+  auto &graph = interferenceResult->getGraph();
+  auto &symbols = interferenceResult->getSymbolTable();
+  auto n = graph.size();
+
+  auto &spillInfo = *result.spillInfo;
+  auto &colorMap = result.colorMap;
+  colorMap.clear();
+
+  auto moves = collectMoves(livenessResult.getStream());
+  auto weights = computeWeights(livenessResult, spillInfo);
+  auto crossesCall = findCallCrossing(livenessResult);
+  GraphColorer colorer(graph, symbols, moves, weights, crossesCall);
+  colorer.color();
+  auto &colors = colorer.getColors();
+  for (int64_t id = 0; id < n; id++)
+    if (colors[id] >= 0)
+      colorMap[symbols.getSymbol(id)] = (Register::ID)colors[id];
 
-  std::unordered_set<const Variable *> uncoloredVars, varsToBeSpilled, unspilledVars;
-  bool spilled, colored;
-  // gather all the nodes that are not colored
-  for (auto &[sym, _] : graph) {
-    if (!dynamic_cast<const Variable *>(sym))
+  std::unordered_set<const Variable *> varsToBeSpilled, unspilledVars;
+  bool uncolored = false;
+  for (int64_t id = 0; id < n; id++) {
+    if (symbols.isRegister(id))
       continue;
-    auto var = dynamic_cast<const Variable *>(sym);
-    spilled = spillInfo.isSpilled(var);
-    colored = colorMap.find(var) != colorMap.end();
-    if (!spilled && !colored)
-      varsToBeSpilled.insert(var);
-    if (!colored)
-      uncoloredVars.insert(var);
-    if (!spilled)
+    auto var = (const Variable *)symbols.getSymbol(id);
+    // variables rewritten in a previous round no longer appear in the function
+    if (result.spilledVars.count(var))
+      continue;
+    if (colors[id] < 0)
+      uncolored = true;
+    if (!spillInfo.isSpilled(var))
       unspilledVars.insert(var);
   }
 
-  if (uncoloredVars.empty()) // all the variables are colored
+  if (!uncolored) { // all the variables are colored
+    result.movesEliminated = countEliminatedMoves(F, colorMap);
     return true;
-  else if (unspilledVars.empty()) // uncolored vars remaining, but all the variables are spilled
+  }
+
+  // only the actual spills are rewritten, the nodes coalesced into them are colored next round
+  for (auto id : colorer.getSpilledNodes()) {
+    auto var = (const Variable *)symbols.getSymbol(id);
+    if (!spillInfo.isSpilled(var)) {
+      varsToBeSpilled.insert(var);
+      result.spillCosts.push_back({var, colorer.getSpillCost(id)});
+    }
+  }
+
+  if (unspilledVars.empty()) // uncolored vars remaining, but all the variables are spilled
     throw std::runtime_error("failed to color the graph");
   else if (varsToBeSpilled.empty()) // spill all the nodes that are not spilled
     varsToBeSpilled = unspilledVars;
 
+  /*
+   * Rather than spilling them everywhere, move variables to memory only around the loops and
+   * calls they are not used in, the graph is then built again for the split live ranges. Any
+   * variable can leave a loop, but only the variables to be spilled are split around calls.
+   * A variable interfering with many other ones would only take the register of another one
+   * where it is kept, it is spilled everywhere instead.
+   */
+  auto fewConflicts = [&](const std::unordered_set<const Variable *> &vars) {
+    std::unordered_set<const Variable *> result;
+    for (auto var : vars) {
+      int64_t varNeighbors = 0;
+      for (auto nbr : graph.getNeighbors(symbols.findID(var)))
+        if (!symbols.isRegister(nbr))
+          varNeighbors++;
+      if (varNeighbors < 2 * K)
+        result.insert(var);
+    }
+    return result;
+  };
+  LiveRangeSplitter splitter(F, livenessResult, spillInfo);
+  auto splitVars = splitter.splitAroundLoops(fewConflicts(unspilledVars));
+  if (splitVars.empty())
+    splitVars = splitter.splitAroundCalls(fewConflicts(varsToBeSpilled));
+  if (!splitVars.empty()) {
+    livenessResult.updateAfterSplit();
+    F->getArena().destroy(interferenceResult);
+    interferenceResult = &analyzeInterference(F, livenessResult, InterferenceMode::DEF_LIVE);
+    return false;
+  }
+
+  // the spilled variables can share stack slots if they do not interfere, record the conflicts
+  // before their nodes are isolated
+  std::vector<const Variable *> conflicts;
+  for (auto var : varsToBeSpilled) {
+    conflicts.clear();
+    for (auto nbr : graph.getNeighbors(symbols.findID(var)))
+      if (!symbols.isRegister(nbr))
+        conflicts.push_back((const Variable *)symbols.getSymbol(nbr));
+    spillInfo.setConflicts(var, conflicts);
+  }
+
   spillFunction(F, *result.spillInfo, livenessResult, varsToBeSpilled);
+
+  std::vector<int64_t> spilledIDs;
+  for (auto var : varsToBeSpilled) {
+    result.spilledVars.insert(var);
+    spilledIDs.push_back(symbols.findID(var));
+  }
+  auto changedBlocks = livenessResult.updateAfterSpill(spilledIDs);
+  interferenceResult->updateAfterSpill(livenessResult, spilledIDs, changedBlocks);
   return false;
 }
 
-const ColorResult &colorGraph(Function *F) {
+const ColorResult &colorGraph(Function *F, LivenessResult &livenessResult) {
   auto prefix = findSpillPrefix(F);
-  auto spillInfo = new SpillInfo(prefix);
+  auto spillInfo = F->getArena().create<SpillInfo>(prefix, F);
 
-  auto &result = *(new ColorResult());
+  auto &result = *F->getArena().create<ColorResult>();
   result.spillInfo = spillInfo;
 
+  auto interferenceResult = &analyzeInterference(F, livenessResult, InterferenceMode::DEF_LIVE);
   while (true)
-    if (tryColor(F, result))
+    if (tryColor(F, livenessResult, interferenceResult, result)) {
+      debug(F->getName() + ": " + std::to_string(result.movesEliminated) + " moves eliminated");
+      F->getArena().destroy(interferenceResult);
       return result;
+    }
 }
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
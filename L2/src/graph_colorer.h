@@ -1,5 +1,10 @@
 #pragma once
 
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
 #include <L2.h>
 #include <interference_analyzer.h>
 #include <liveness_analyzer.h>
@@ -13,15 +18,43 @@ class ColorResult {
 public:
   const ColorMap &getColorMap() const;
   const SpillInfo &getSpillInfo() const;
+
+  /*
+   * Number of moves whose two ends have been given the same register.
+   */
+  int64_t getMovesEliminated() const;
   void dump() const;
 
 private:
   ColorMap colorMap;
   SpillInfo *spillInfo;
+  int64_t movesEliminated = 0;
+  // variables spilled so far with the spill cost they were chosen with
+  std::vector<std::pair<const Variable *, double>> spillCosts;
+
+  // variables rewritten by the spiller so far
+  std::unordered_set<const Variable *> spilledVars;
 
-  friend const ColorResult &colorGraph(Function *F);
-  friend bool tryColor(Function *F, ColorResult &result);
+  friend const ColorResult &colorGraph(Function *F, LivenessResult &livenessResult);
+  friend bool tryColor(Function *F, LivenessResult &livenessResult,
+                       InterferenceResult *&interferenceResult, ColorResult &result);
+  friend const ColorResult &allocateLinearScan(Function *F, LivenessResult &livenessResult,
+                                               bool splitAtCalls);
 };
 
-const ColorResult &colorGraph(Function *F);
+/*
+ * Name of the variables introduced by spilling F, longer than any variable of F.
+ */
+std::string findSpillPrefix(Function *F);
+
+/*
+ * Number of moves of F whose two ends are given the same register by colorMap.
+ */
+int64_t countEliminatedMoves(const Function *F, const ColorMap &colorMap);
+
+/*
+ * Assign a register to every variable of F, spilling as needed.
+ * livenessResult must be the liveness of F, it is kept up to date with the spills.
+ */
+const ColorResult &colorGraph(Function *F, LivenessResult &livenessResult);
 } // namespace L2
\ No newline at end of file
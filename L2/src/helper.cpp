@@ -1,10 +1,17 @@
+#include <atomic>
 #include <iostream>
+#include <mutex>
 
 #include <helper.h>
 
-bool debugEnabled = false;
+std::atomic<bool> debugEnabled{false};
+
+// functions are compiled in parallel, keep the messages from interleaving
+static std::mutex debugMutex;
 
 void debug(std::string message) {
-  if (debugEnabled)
-    std::cerr << "\033[33m[DEBUG] " << message << "\033[0m" << std::endl;
+  if (!debugEnabled)
+    return;
+  std::lock_guard<std::mutex> lock(debugMutex);
+  std::cerr << "\033[33m[DEBUG] " << message << "\033[0m" << std::endl;
 }
\ No newline at end of file
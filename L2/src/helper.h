@@ -1,6 +1,7 @@
 #pragma once
+#include <atomic>
 #include <string>
 
-extern bool debugEnabled;
+extern std::atomic<bool> debugEnabled;
 
 void debug(std::string message);
\ No newline at end of file
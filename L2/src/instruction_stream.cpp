@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <L2.h>
+#include <dataflow.h>
+#include <instruction_stream.h>
+#include <symbol_table.h>
+
+namespace L2 {
+
+/*
+ * Lower one instruction to a row of the stream: the symbols it generates and kills, and the
+ * operands kept for the passes.
+ */
+class InstructionLowerer : public Visitor {
+public:
+  void visit(const Register *reg) override {
+    if (reg->getID() == Register::ID::RSP)
+      return;
+    now->push_back(reg->getID());
+  }
+
+  void visit(const Variable *var) override { now->push_back(symbols->getID(var)); }
+
+  void visit(const Number *num) override {}
+  void visit(const CompareOp *op) override {}
+  void visit(const ShiftOp *op) override {}
+  void visit(const ArithOp *op) override {}
+  void visit(const SelfModOp *op) override {}
+
+  void visit(const MemoryLocation *mem) override {
+    // no matter how mem loc is accessed, the base register is always brought alive
+    auto original = now;
+    now = &GEN;
+    mem->getBase()->accept(*this);
+    now = original;
+  }
+  void visit(const StackLocation *stack) override {}
+  void visit(const FunctionName *name) override {}
+  void visit(const Label *label) override {}
+
+  void visit(const RetInst *inst) override {
+    GEN.push_back(Register::ID::RAX);
+    for (auto reg : calleeSaved)
+      GEN.push_back(reg->getID());
+  }
+
+  void visit(const ShiftInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getLval()->accept(*this);
+    inst->getRval()->accept(*this);
+    pureDef = findID(inst->getLval());
+    shiftAmount = findID(inst->getRval());
+  }
+
+  void visit(const ArithInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getLval()->accept(*this);
+    inst->getRval()->accept(*this);
+    pureDef = findID(inst->getLval());
+  }
+
+  void visit(const SelfModInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getLval()->accept(*this);
+    pureDef = findID(inst->getLval());
+  }
+
+  void visit(const AssignInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getRval()->accept(*this);
+    pureDef = findID(inst->getLval());
+    if (!isa<Symbol>(inst->getLval()))
+      return;
+
+    auto rval = inst->getRval();
+    if (isa<Symbol>(rval))
+      moveSource = findID(rval);
+    else if (isa<Number>(rval) || isa<Label>(rval) || isa<FunctionName>(rval))
+      constant = rval;
+  }
+
+  void visit(const CompareAssignInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getCmpLval()->accept(*this);
+    inst->getCmpRval()->accept(*this);
+    pureDef = findID(inst->getLval());
+  }
+
+  void visit(const CallInst *inst) override {
+    handleCall(inst->getArgNum()->getVal());
+    now = &GEN;
+    inst->getCallee()->accept(*this);
+  }
+
+  void visit(const PrintInst *inst) override { handleCall(1); }
+
+  void visit(const InputInst *inst) override { handleCall(0); }
+
+  void visit(const AllocateInst *inst) override { handleCall(2); }
+
+  void visit(const TupleErrorInst *inst) override { handleCall(3); }
+
+  void visit(const TensorErrorInst *inst) override { handleCall(inst->getArgNum()->getVal()); }
+
+  void visit(const SetInst *inst) override {
+    now = &KILL;
+    inst->getLval()->accept(*this);
+    now = &GEN;
+    inst->getBase()->accept(*this);
+    inst->getOffset()->accept(*this);
+    pureDef = findID(inst->getLval());
+  }
+  void visit(const LabelInst *inst) override {}
+
+  void visit(const GotoInst *inst) override {}
+
+  void visit(const CondJumpInst *inst) override {
+    now = &GEN;
+    inst->getLval()->accept(*this);
+    inst->getRval()->accept(*this);
+  }
+
+  void lower(const Instruction *I, SymbolTable *symbols) {
+    this->symbols = symbols;
+    GEN.clear();
+    KILL.clear();
+    moveSource = shiftAmount = pureDef = -1;
+    constant = nullptr;
+    I->accept(*this);
+  }
+
+  // the row of the last lowered instruction
+  std::vector<int32_t> GEN, KILL;
+  int64_t moveSource, shiftAmount, pureDef;
+  const Item *constant;
+
+private:
+  std::vector<int32_t> *now;
+  SymbolTable *symbols;
+
+  // used as a readonly buffer
+  const std::unordered_set<const Register *> &callerSaved = Register::getCallerSavedRegisters(),
+                                             &calleeSaved = Register::getCalleeSavedRegisters();
+  const std::vector<const Register *> &args = Register::getArgRegisters();
+
+  // the symbols have been numbered when the operands are visited, rsp never is
+  int64_t findID(const Item *item) const {
+    auto sym = dyn_cast<Symbol>(item);
+    return sym == nullptr ? -1 : symbols->findID(sym);
+  }
+
+  void handleCall(int64_t argNum) {
+    for (auto reg : callerSaved)
+      KILL.push_back(reg->getID());
+    for (int i = 0; i < std::min(argNum, (int64_t)6); i++)
+      GEN.push_back(args[i]->getID());
+  }
+};
+
+void InstructionStream::clear() {
+  blockStart.clear();
+  instructions.clear();
+  kinds.clear();
+  genStart.assign(1, 0);
+  killStart.assign(1, 0);
+  genIDs.clear();
+  killIDs.clear();
+  moveSources.clear();
+  shiftAmounts.clear();
+  pureDefs.clear();
+  constantIndices.clear();
+  constants.clear();
+}
+
+void InstructionStream::append(InstructionLowerer &lowerer, const Instruction *I) {
+  instructions.push_back(I);
+  kinds.push_back(I->getKind());
+  genIDs.insert(genIDs.end(), lowerer.GEN.begin(), lowerer.GEN.end());
+  killIDs.insert(killIDs.end(), lowerer.KILL.begin(), lowerer.KILL.end());
+  genStart.push_back(genIDs.size());
+  killStart.push_back(killIDs.size());
+  moveSources.push_back(lowerer.moveSource);
+  shiftAmounts.push_back(lowerer.shiftAmount);
+  pureDefs.push_back(lowerer.pureDef);
+  if (lowerer.constant == nullptr)
+    constantIndices.push_back(-1);
+  else {
+    constantIndices.push_back(constants.size());
+    constants.push_back(lowerer.constant);
+  }
+}
+
+void InstructionStream::copyRow(const InstructionStream &other, int64_t i) {
+  instructions.push_back(other.instructions[i]);
+  kinds.push_back(other.kinds[i]);
+  auto GEN = other.getGEN(i), KILL = other.getKILL(i);
+  genIDs.insert(genIDs.end(), GEN.begin(), GEN.end());
+  killIDs.insert(killIDs.end(), KILL.begin(), KILL.end());
+  genStart.push_back(genIDs.size());
+  killStart.push_back(killIDs.size());
+  moveSources.push_back(other.moveSources[i]);
+  shiftAmounts.push_back(other.shiftAmounts[i]);
+  pureDefs.push_back(other.pureDefs[i]);
+  if (other.constantIndices[i] < 0)
+    constantIndices.push_back(-1);
+  else {
+    constantIndices.push_back(constants.size());
+    constants.push_back(other.constants[other.constantIndices[i]]);
+  }
+}
+
+void InstructionStream::build(const BlockGraph &graph, SymbolTable &symbols) {
+  clear();
+  InstructionLowerer lowerer;
+  for (int64_t b = 0; b < graph.size(); b++) {
+    blockStart.push_back(size());
+    for (auto I : graph.getBlock(b)->getInstructions()) {
+      lowerer.lower(I, &symbols);
+      append(lowerer, I);
+    }
+  }
+  blockStart.push_back(size());
+}
+
+std::vector<int64_t> InstructionStream::update(const BlockGraph &graph, SymbolTable &symbols) {
+  InstructionStream old;
+  std::swap(*this, old);
+  clear();
+
+  // copy the rows of the unchanged blocks, lower the instructions of the rewritten ones again
+  InstructionLowerer lowerer;
+  std::vector<int64_t> changedBlocks;
+  for (int64_t b = 0; b < graph.size(); b++) {
+    blockStart.push_back(size());
+    auto &blockInstructions = graph.getBlock(b)->getInstructions();
+    auto first = old.blockStart[b], last = old.blockStart[b + 1];
+    auto unchanged =
+        (int64_t)blockInstructions.size() == last - first &&
+        std::equal(blockInstructions.begin(), blockInstructions.end(),
+                   old.instructions.begin() + first);
+    if (unchanged) {
+      for (auto i = first; i < last; i++)
+        copyRow(old, i);
+      continue;
+    }
+
+    changedBlocks.push_back(b);
+    for (auto I : blockInstructions) {
+      lowerer.lower(I, &symbols);
+      append(lowerer, I);
+    }
+  }
+  blockStart.push_back(size());
+  return changedBlocks;
+}
+
+} // namespace L2
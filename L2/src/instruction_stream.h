@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <L2.h>
+#include <dataflow.h>
+#include <symbol_table.h>
+
+namespace L2 {
+
+class InstructionLowerer;
+
+/*
+ * Read only range of symbol IDs.
+ */
+class IDList {
+public:
+  IDList(const int32_t *first, const int32_t *last) : first{first}, last{last} {}
+  const int32_t *begin() const { return first; }
+  const int32_t *end() const { return last; }
+  bool empty() const { return first == last; }
+
+private:
+  const int32_t *first, *last;
+};
+
+/*
+ * Struct of arrays encoding of the instructions of a function, in block order.
+ *
+ * Row i holds the kind of the i-th instruction, the ranges of the IDs of the symbols it uses
+ * (GEN) and defines (KILL) in two packed ID arrays, and the few operands the passes test on their
+ * hot paths, so that they walk plain arrays instead of visiting the instruction objects. The
+ * constants assigned to symbols are kept in a side table.
+ *
+ * The instructions are lowered once, afterwards only the blocks rewritten by a pass are lowered
+ * again. The symbols are numbered in the SymbolTable while lowering.
+ */
+class InstructionStream {
+public:
+  int64_t size() const { return kinds.size(); }
+
+  /*
+   * The instructions of block b are the rows [getBlockStart(b), getBlockStart(b + 1)).
+   */
+  int64_t getBlockStart(int64_t b) const { return blockStart[b]; }
+
+  const Instruction *getInstruction(int64_t i) const { return instructions[i]; }
+  Instruction::Kind getKind(int64_t i) const { return (Instruction::Kind)kinds[i]; }
+
+  /*
+   * IDs of the symbols generated / killed by row i, possibly with duplicates.
+   */
+  IDList getGEN(int64_t i) const {
+    return {genIDs.data() + genStart[i], genIDs.data() + genStart[i + 1]};
+  }
+  IDList getKILL(int64_t i) const {
+    return {killIDs.data() + killStart[i], killIDs.data() + killStart[i + 1]};
+  }
+
+  /*
+   * Call, print, input or allocate: the caller saved registers do not survive the instruction.
+   */
+  bool isCall(int64_t i) const {
+    auto kind = getKind(i);
+    return kind == Instruction::CALL || kind == Instruction::PRINT ||
+           kind == Instruction::INPUT || kind == Instruction::ALLOCATE;
+  }
+
+  // ID of the source of a move between two symbols, -1 otherwise
+  int64_t getMoveSource(int64_t i) const { return moveSources[i]; }
+  // ID of the symbol holding the amount of a shift, -1 if it is a number
+  int64_t getShiftAmount(int64_t i) const { return shiftAmounts[i]; }
+  // ID of the symbol defined by an instruction without any other effect, -1 otherwise
+  int64_t getPureDef(int64_t i) const { return pureDefs[i]; }
+  bool isSelfMove(int64_t i) const { return moveSources[i] >= 0 && moveSources[i] == pureDefs[i]; }
+
+  /*
+   * Number, label or function name assigned to a symbol by row i, nullptr otherwise.
+   */
+  const Item *getConstant(int64_t i) const {
+    return constantIndices[i] < 0 ? nullptr : constants[constantIndices[i]];
+  }
+
+  /*
+   * Lower the instructions of every block of graph.
+   */
+  void build(const BlockGraph &graph, SymbolTable &symbols);
+
+  /*
+   * Lower again the blocks whose instructions are not the ones they had when they were last
+   * lowered, the rows of the other blocks are kept. Returns the indices of the changed blocks.
+   */
+  std::vector<int64_t> update(const BlockGraph &graph, SymbolTable &symbols);
+
+private:
+  std::vector<int64_t> blockStart;
+
+  std::vector<const Instruction *> instructions;
+  std::vector<uint8_t> kinds;
+  std::vector<int32_t> genStart, killStart;
+  std::vector<int32_t> genIDs, killIDs;
+  std::vector<int32_t> moveSources, shiftAmounts, pureDefs, constantIndices;
+  std::vector<const Item *> constants;
+
+  void append(InstructionLowerer &lowerer, const Instruction *I);
+  void copyRow(const InstructionStream &other, int64_t i);
+  void clear();
+};
+
+} // namespace L2
@@ -1,77 +1,197 @@
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include <L2.h>
+#include <instruction_stream.h>
 #include <interference_analyzer.h>
-#include <unordered_set>
 
 namespace L2 {
 
-const std::unordered_set<const Symbol *> &InterferenceResult::getNeighbors(const Symbol *s) const {
-  return graph.at(s);
+InterferenceGraph::InterferenceGraph(int64_t size) : numNodes{0} { resize(size); }
+
+int64_t InterferenceGraph::size() const { return numNodes; }
+
+void InterferenceGraph::resize(int64_t size) {
+  // row i of the triangle holds the i bits of the pairs (i, 0..i-1), so growing only appends
+  numNodes = size;
+  matrix.resize((size * (size - 1) / 2 + 63) / 64 + 1, 0);
+  adjacency.resize(size);
+}
+
+int64_t InterferenceGraph::bitIndex(int64_t a, int64_t b) {
+  if (a < b)
+    std::swap(a, b);
+  return a * (a - 1) / 2 + b;
 }
-const InterferenceGraph &InterferenceResult::getGraph() const { return graph; }
 
-void InterferenceResult::addEdge(const Symbol *s1, const Symbol *s2) {
-  // if node is not in graph, add it
-  if (graph.find(s1) == graph.end())
-    graph[s1] = std::unordered_set<const Symbol *>();
-  if (graph.find(s2) == graph.end())
-    graph[s2] = std::unordered_set<const Symbol *>();
+bool InterferenceGraph::interferes(int64_t a, int64_t b) const {
+  if (a == b)
+    return false;
+  auto i = bitIndex(a, b);
+  return (matrix[i >> 6] >> (i & 63)) & 1;
+}
+
+const std::vector<int64_t> &InterferenceGraph::getNeighbors(int64_t a) const {
+  return adjacency[a];
+}
 
-  if (s1 == s2)
+int64_t InterferenceGraph::getDegree(int64_t a) const { return adjacency[a].size(); }
+
+void InterferenceGraph::addEdge(int64_t a, int64_t b) {
+  if (a == b)
+    return;
+  auto i = bitIndex(a, b);
+  auto &word = matrix[i >> 6];
+  auto mask = (uint64_t)1 << (i & 63);
+  if (word & mask)
     return;
+  word |= mask;
+  adjacency[a].push_back(b);
+  adjacency[b].push_back(a);
+}
 
-  graph[s1].insert(s2);
-  graph[s2].insert(s1);
+void InterferenceGraph::isolate(const std::vector<int64_t> &nodes) {
+  std::vector<bool> isolated(numNodes, false), touched(numNodes, false);
+  std::vector<int64_t> neighbors;
+  for (auto a : nodes)
+    isolated[a] = true;
+
+  for (auto a : nodes) {
+    for (auto nbr : adjacency[a]) {
+      auto i = bitIndex(a, nbr);
+      matrix[i >> 6] &= ~((uint64_t)1 << (i & 63));
+      if (!isolated[nbr] && !touched[nbr]) {
+        touched[nbr] = true;
+        neighbors.push_back(nbr);
+      }
+    }
+    adjacency[a].clear();
+  }
+
+  // the registers neighbor almost every node, so each list is filtered only once
+  for (auto nbr : neighbors) {
+    auto &nbrAdjacency = adjacency[nbr];
+    nbrAdjacency.erase(std::remove_if(nbrAdjacency.begin(), nbrAdjacency.end(),
+                                      [&](int64_t id) { return isolated[id]; }),
+                       nbrAdjacency.end());
+  }
 }
 
+InterferenceResult::InterferenceResult(const SymbolTable &symbols, InterferenceMode mode)
+    : symbols{symbols}, mode{mode}, graph{symbols.size()} {}
+
+const InterferenceGraph &InterferenceResult::getGraph() const { return graph; }
+
+const SymbolTable &InterferenceResult::getSymbolTable() const { return symbols; }
+
+void InterferenceResult::addEdge(int64_t a, int64_t b) { graph.addEdge(a, b); }
+
 void InterferenceResult::dump() const {
-  for (auto &[symbol, intSyms] : graph) {
-    std::cout << symbol->toStr() << " ";
+  for (int64_t id = 0; id < graph.size(); id++) {
+    std::cout << symbols.getSymbol(id)->toStr() << " ";
 
-    for (auto intSym : intSyms)
-      std::cout << intSym->toStr() << " ";
+    for (auto nbr : graph.getNeighbors(id))
+      std::cout << symbols.getSymbol(nbr)->toStr() << " ";
 
     std::cout << std::endl;
   }
 }
 
-InterferenceResult &analyzeInterference(const Function *F, const LivenessResult &livenessResult) {
-  auto *interferenceGraph = new InterferenceResult();
+void addShiftEdges(InterferenceResult &interferenceGraph, const InstructionStream &stream,
+                   int64_t i) {
+  // the shift amount can only be held by rcx
+  auto amount = stream.getShiftAmount(i);
+  if (amount < 0)
+    return;
+  for (auto reg : Register::getAllGPRegisters())
+    if (reg->getID() != Register::ID::RCX)
+      interferenceGraph.addEdge(amount, reg->getID());
+}
+
+void addPairwiseEdges(const BasicBlock *BB, const LivenessResult &livenessResult,
+                      InterferenceResult &interferenceGraph) {
+  auto &stream = livenessResult.getStream();
+  auto i = stream.getBlockStart(livenessResult.getBlockGraph().getIndex(BB) + 1);
+  livenessResult.scanBlock(BB, [&](const Instruction *I, const LivenessSets &livenessSets) {
+    auto &IN = livenessSets.getINBits(), &OUT = livenessSets.getOUTBits(),
+         &KILL = livenessSets.getKILLBits();
+
+    IN.forEach([&](int64_t id1) {
+      IN.forEach([&](int64_t id2) { interferenceGraph.addEdge(id1, id2); });
+    });
+
+    OUT.forEach([&](int64_t id1) {
+      OUT.forEach([&](int64_t id2) { interferenceGraph.addEdge(id1, id2); });
+    });
+
+    KILL.forEach([&](int64_t killID) {
+      OUT.forEach([&](int64_t outID) { interferenceGraph.addEdge(killID, outID); });
+    });
+
+    addShiftEdges(interferenceGraph, stream, --i);
+  });
+}
+
+void addDefLiveEdges(const BasicBlock *BB, const LivenessResult &livenessResult,
+                     InterferenceResult &interferenceGraph) {
+  auto &stream = livenessResult.getStream();
+  livenessResult.scanBlockLive(
+      BB, [&](int64_t i, const BitVector &live, const IDList &GEN, const IDList &KILL) {
+        // a move does not make its destination interfere with its source
+        auto moveSource = stream.getMoveSource(i);
+        for (auto def : KILL)
+          live.forEach([&](int64_t liveID) {
+            if (liveID != moveSource)
+              interferenceGraph.addEdge(def, liveID);
+          });
+
+        addShiftEdges(interferenceGraph, stream, i);
+      });
+}
+
+void addBlockEdges(const BasicBlock *BB, const LivenessResult &livenessResult,
+                   InterferenceResult &interferenceGraph, InterferenceMode mode) {
+  if (mode == InterferenceMode::PAIRWISE)
+    addPairwiseEdges(BB, livenessResult, interferenceGraph);
+  else
+    addDefLiveEdges(BB, livenessResult, interferenceGraph);
+}
+
+void InterferenceResult::updateAfterSpill(const LivenessResult &livenessResult,
+                                          const std::vector<int64_t> &spilledIDs,
+                                          const std::vector<int64_t> &changedBlocks) {
+  graph.resize(symbols.size());
+  graph.isolate(spilledIDs);
+
+  auto &blockGraph = livenessResult.getBlockGraph();
+  for (auto b : changedBlocks)
+    addBlockEdges(blockGraph.getBlock(b), livenessResult, *this, mode);
+}
+
+InterferenceResult &analyzeInterference(const Function *F, const LivenessResult &livenessResult,
+                                        InterferenceMode mode) {
+  auto &symbols = livenessResult.getSymbolTable();
+  auto *interferenceGraph = F->getArena().create<InterferenceResult>(symbols, mode);
   auto &allGPRegisters = Register::getAllGPRegisters();
 
   // connect all GP registers
   for (auto reg1 : allGPRegisters)
     for (auto reg2 : allGPRegisters)
-      interferenceGraph->addEdge(reg1, reg2);
-
-  for (auto BB : F->getBasicBlocks()) {
-    for (auto I : BB->getInstructions()) {
-      auto &livenessSets = livenessResult.getLivenessSets(I);
-      auto &IN = livenessSets.getIN(), &OUT = livenessSets.getOUT(), &KILL = livenessSets.getKILL();
-
-      for (auto sym1 : IN)
-        for (auto sym2 : IN)
-          interferenceGraph->addEdge(sym1, sym2);
-
-      for (auto sym1 : OUT)
-        for (auto sym2 : OUT)
-          interferenceGraph->addEdge(sym1, sym2);
-
-      for (auto killSym : KILL)
-        for (auto outSym : OUT)
-          interferenceGraph->addEdge(killSym, outSym);
-
-      // add instruction specific edges
-      if (auto shiftInst = dynamic_cast<const ShiftInst *>(I))
-        if (auto rVal = dynamic_cast<const Symbol *>(shiftInst->getRval()))
-          for (auto reg : allGPRegisters)
-            if (reg->getID() != Register::ID::RCX)
-              interferenceGraph->addEdge(rVal, reg);
-    }
+      interferenceGraph->addEdge(reg1->getID(), reg2->getID());
+
+  // with DEF_LIVE, symbols live at the entry have no definition to be connected at
+  if (mode == InterferenceMode::DEF_LIVE && !F->getBasicBlocks().empty()) {
+    auto &entryIN = livenessResult.getBlockIN(F->getBasicBlocks().front());
+    entryIN.forEach([&](int64_t id1) {
+      entryIN.forEach([&](int64_t id2) { interferenceGraph->addEdge(id1, id2); });
+    });
   }
 
+  for (auto BB : F->getBasicBlocks())
+    addBlockEdges(BB, livenessResult, *interferenceGraph, mode);
+
   return *interferenceGraph;
 }
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
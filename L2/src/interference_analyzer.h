@@ -1,35 +1,95 @@
 #pragma once
-#include <map>
+
+#include <cstdint>
+#include <vector>
 
 #include <L2.h>
 #include <liveness_analyzer.h>
 #include <spiller.h>
-#include <unordered_set>
+#include <symbol_table.h>
 
 namespace L2 {
 
-typedef std::map<const Symbol *, std::unordered_set<const Symbol *>> InterferenceGraph;
+/*
+ * Undirected graph over dense node IDs.
+ * Edges are stored twice: in a lower triangular bit matrix for O(1) membership tests, and in
+ * adjacency vectors for neighbor iteration.
+ */
+class InterferenceGraph {
+public:
+  InterferenceGraph(int64_t size);
+  int64_t size() const;
+  void resize(int64_t size);
+  bool interferes(int64_t a, int64_t b) const;
+  const std::vector<int64_t> &getNeighbors(int64_t a) const;
+  int64_t getDegree(int64_t a) const;
+
+  /*
+   * Add an edge between two nodes.
+   * If the nodes are the same or the edge already exists, do nothing.
+   */
+  void addEdge(int64_t a, int64_t b);
+
+  /*
+   * Remove all the edges of the given nodes.
+   */
+  void isolate(const std::vector<int64_t> &nodes);
+
+private:
+  int64_t numNodes;
+  std::vector<uint64_t> matrix;
+  std::vector<std::vector<int64_t>> adjacency;
+
+  static int64_t bitIndex(int64_t a, int64_t b);
+};
+
+enum class InterferenceMode {
+  /*
+   * Symbols in the same IN or OUT set interfere, and so do KILL and OUT.
+   * Quadratic in the size of the live sets for every instruction.
+   */
+  PAIRWISE,
+
+  /*
+   * Chaitin style construction: a single backward scan per block connects the symbols defined by
+   * an instruction with the symbols live after it, except the source of a move.
+   * Proportional to the number of real edges.
+   */
+  DEF_LIVE
+};
 
 class InterferenceResult {
 public:
-  InterferenceResult() = default;
-  const std::unordered_set<const Symbol *> &getNeighbors(const Symbol *s) const;
+  InterferenceResult(const SymbolTable &symbols, InterferenceMode mode);
   const InterferenceGraph &getGraph() const;
+
+  /*
+   * The nodes of the graph are the IDs of this table.
+   */
+  const SymbolTable &getSymbolTable() const;
   void dump() const;
 
+  void addEdge(int64_t a, int64_t b);
+
   /*
-   * Add an edge between two symbols.
-   * If the symbols are the same, do nothing.
+   * Patch the graph after the liveness result has been updated for a spill: the spilled
+   * variables lose all their edges and only the changed blocks are scanned again, adding the
+   * edges of the spill temporaries.
    */
-  void addEdge(const Symbol *s1, const Symbol *s2);
+  void updateAfterSpill(const LivenessResult &livenessResult,
+                        const std::vector<int64_t> &spilledIDs,
+                        const std::vector<int64_t> &changedBlocks);
 
 private:
+  const SymbolTable &symbols;
+  InterferenceMode mode;
   InterferenceGraph graph;
 
   InterferenceResult &operator=(const InterferenceResult &) = delete;
   InterferenceResult(const InterferenceResult &) = delete;
 };
 
-InterferenceResult &analyzeInterference(const Function *F, const LivenessResult &livenessResult);
+InterferenceResult &analyzeInterference(const Function *F, const LivenessResult &livenessResult,
+                                        InterferenceMode mode = InterferenceMode::PAIRWISE);
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <L2.h>
+#include <graph_colorer.h>
+#include <helper.h>
+#include <linear_scan.h>
+#include <live_range_splitter.h>
+#include <liveness_analyzer.h>
+#include <spiller.h>
+
+namespace L2 {
+
+const static auto scanPriority = {
+    Register::ID::R10, Register::ID::R11, Register::ID::R8,  Register::ID::R9,  Register::ID::RAX,
+    Register::ID::RCX, Register::ID::RDI, Register::ID::RDX, Register::ID::RSI, Register::ID::R12,
+    Register::ID::R13, Register::ID::R14, Register::ID::R15, Register::ID::RBP, Register::ID::RBX};
+
+/*
+ * Half open range of positions [from, to).
+ */
+struct Range {
+  int64_t from, to;
+};
+
+/*
+ * Linear scan (Poletto and Sarkar) over the live intervals of one function.
+ *
+ * The blocks are laid out in their order in the function, the k-th instruction reads its operands
+ * at position 2k and writes its results at 2k + 1. Each symbol gets the sorted list of ranges it
+ * is live in, built from the block OUT sets and a backward scan of each block.
+ *
+ * Variables are visited by increasing start. A register can be given to a variable if it is not
+ * live in one of its ranges, e.g. a caller saved register as long as the variable is not live
+ * across a call, and if none of the active variables holding it is live there either: a variable
+ * can sit in the lifetime hole of another one (Traub et al.). When no register is left, the
+ * variables in the way of the register freed last are spilled, or the current one if it ends
+ * later than them.
+ */
+class LinearScan {
+public:
+  LinearScan(const Function *F, const LivenessResult &livenessResult, const SpillInfo &spillInfo);
+
+  /*
+   * Returns false if some variables have to be spilled.
+   */
+  bool allocate();
+
+  // register of each symbol, -1 if it has none
+  const std::vector<int64_t> &getColors() const;
+  const std::vector<int64_t> &getSpilledNodes() const;
+
+private:
+  const SymbolTable &symbols;
+  std::vector<std::vector<Range>> ranges;
+  // the shift amount can only be held by rcx
+  std::vector<bool> rcxOnly;
+  // the variables introduced by spilling can not be spilled again
+  std::vector<bool> unspillable;
+  // symbol moved to or from each symbol, preferably given the same register
+  std::vector<int64_t> hints;
+
+  std::vector<int64_t> colors, spilledNodes;
+
+  void buildIntervals(const LivenessResult &livenessResult);
+  void addRange(int64_t id, int64_t from, int64_t to);
+  void setFrom(int64_t id, int64_t from);
+
+  int64_t start(int64_t id) const { return ranges[id].front().from; }
+  int64_t end(int64_t id) const { return ranges[id].back().to; }
+  bool canTake(int64_t id, int64_t reg) const;
+  bool intersects(int64_t id1, int64_t id2) const;
+};
+
+LinearScan::LinearScan(const Function *F, const LivenessResult &livenessResult,
+                       const SpillInfo &spillInfo)
+    : symbols{livenessResult.getSymbolTable()}, ranges(symbols.size()),
+      rcxOnly(symbols.size(), false), unspillable(symbols.size(), false),
+      hints(symbols.size(), -1), colors(symbols.size(), -1) {
+  for (int64_t id = 0; id < symbols.size(); id++)
+    if (symbols.isRegister(id))
+      colors[id] = id;
+    else
+      unspillable[id] = spillInfo.isSpilled((const Variable *)symbols.getSymbol(id));
+
+  auto &stream = livenessResult.getStream();
+  for (int64_t i = 0; i < stream.size(); i++) {
+    if (stream.getShiftAmount(i) >= 0)
+      rcxOnly[stream.getShiftAmount(i)] = true;
+
+    // rsp is never numbered
+    auto dst = stream.getPureDef(i), src = stream.getMoveSource(i);
+    if (dst < 0 || src < 0 || dst == src)
+      continue;
+    if (hints[dst] < 0)
+      hints[dst] = src;
+    if (hints[src] < 0)
+      hints[src] = dst;
+  }
+
+  buildIntervals(livenessResult);
+}
+
+void LinearScan::addRange(int64_t id, int64_t from, int64_t to) {
+  // ranges are built backward, the last one is the earliest so far
+  auto &symbolRanges = ranges[id];
+  if (!symbolRanges.empty() && symbolRanges.back().from <= to) {
+    symbolRanges.back().from = std::min(symbolRanges.back().from, from);
+    symbolRanges.back().to = std::max(symbolRanges.back().to, to);
+  } else
+    symbolRanges.push_back({from, to});
+}
+
+void LinearScan::setFrom(int64_t id, int64_t from) {
+  auto &symbolRanges = ranges[id];
+  if (!symbolRanges.empty() && symbolRanges.back().from <= from && from < symbolRanges.back().to)
+    symbolRanges.back().from = from;
+  else // the definition is dead, the symbol still occupies its register while it is written
+    symbolRanges.push_back({from, from + 1});
+}
+
+void LinearScan::buildIntervals(const LivenessResult &livenessResult) {
+  auto &graph = livenessResult.getBlockGraph();
+  auto &stream = livenessResult.getStream();
+
+  // the rows of the stream are the instructions in layout order
+  for (auto b = graph.size() - 1; b >= 0; b--) {
+    auto BB = graph.getBlock(b);
+    auto blockFrom = 2 * stream.getBlockStart(b), blockTo = 2 * stream.getBlockStart(b + 1);
+    livenessResult.getBlockOUT(BB).forEach(
+        [&](int64_t id) { addRange(id, blockFrom, blockTo); });
+
+    livenessResult.scanBlockGenKill(BB, [&](int64_t i, const IDList &GEN, const IDList &KILL) {
+      for (auto id : KILL)
+        setFrom(id, 2 * i + 1);
+      for (auto id : GEN)
+        addRange(id, blockFrom, 2 * i + 1);
+    });
+  }
+
+  for (auto &symbolRanges : ranges)
+    std::reverse(symbolRanges.begin(), symbolRanges.end());
+}
+
+bool LinearScan::canTake(int64_t id, int64_t reg) const {
+  if (rcxOnly[id] && reg != Register::ID::RCX)
+    return false;
+
+  auto &regRanges = ranges[reg];
+  for (auto &range : ranges[id]) {
+    // first range of the register ending after this one starts
+    auto it = std::upper_bound(regRanges.begin(), regRanges.end(), range.from,
+                               [](int64_t pos, const Range &r) { return pos < r.to; });
+    if (it != regRanges.end() && it->from < range.to)
+      return false;
+  }
+  return true;
+}
+
+bool LinearScan::intersects(int64_t id1, int64_t id2) const {
+  auto &ranges1 = ranges[id1], &ranges2 = ranges[id2];
+  auto it1 = ranges1.begin(), it2 = ranges2.begin();
+  while (it1 != ranges1.end() && it2 != ranges2.end()) {
+    if (it1->to <= it2->from)
+      it1++;
+    else if (it2->to <= it1->from)
+      it2++;
+    else
+      return true;
+  }
+  return false;
+}
+
+bool LinearScan::allocate() {
+  std::vector<int64_t> order;
+  for (int64_t id = 0; id < symbols.size(); id++)
+    // variables spilled in a previous round no longer appear in the function
+    if (!symbols.isRegister(id) && !ranges[id].empty())
+      order.push_back(id);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int64_t a, int64_t b) { return start(a) < start(b); });
+
+  // variables holding a register whose interval is not over yet, by increasing end
+  std::vector<int64_t> active;
+  std::vector<int64_t> conflicting;
+
+  for (auto id : order) {
+    auto expired = 0;
+    while (expired < (int64_t)active.size() && end(active[expired]) <= start(id))
+      expired++;
+    active.erase(active.begin(), active.begin() + expired);
+
+    // the end of the first variable to spill to free each register, -1 if it is free
+    int64_t bestReg = -1, bestEnd = -1;
+    auto tryRegister = [&](int64_t reg) {
+      if (!canTake(id, reg))
+        return false;
+      int64_t firstEnd = -1;
+      for (auto other : active)
+        if (colors[other] == reg && intersects(id, other)) {
+          if (unspillable[other])
+            return false;
+          firstEnd = firstEnd < 0 ? end(other) : std::min(firstEnd, end(other));
+        }
+      if (firstEnd < 0)
+        return true;
+      if (firstEnd > bestEnd) {
+        bestReg = reg;
+        bestEnd = firstEnd;
+      }
+      return false;
+    };
+
+    auto hint = hints[id];
+    if (hint >= 0 && colors[hint] >= 0 && tryRegister(colors[hint]))
+      colors[id] = colors[hint];
+    else
+      for (auto reg : scanPriority)
+        if (tryRegister(reg)) {
+          colors[id] = reg;
+          break;
+        }
+
+    if (colors[id] < 0) {
+      // spill the variables in the way if they all end after this one
+      if (bestReg < 0 || (bestEnd <= end(id) && !unspillable[id])) {
+        if (unspillable[id])
+          throw std::runtime_error("failed to allocate the registers");
+        spilledNodes.push_back(id);
+        continue;
+      }
+
+      conflicting.clear();
+      for (auto other : active)
+        if (colors[other] == bestReg && intersects(id, other))
+          conflicting.push_back(other);
+      for (auto other : conflicting) {
+        colors[other] = -1;
+        spilledNodes.push_back(other);
+        active.erase(std::find(active.begin(), active.end(), other));
+      }
+      colors[id] = bestReg;
+    }
+
+    auto pos = std::upper_bound(active.begin(), active.end(), end(id),
+                                [&](int64_t e, int64_t other) { return e < end(other); });
+    active.insert(pos, id);
+  }
+
+  return spilledNodes.empty();
+}
+
+const std::vector<int64_t> &LinearScan::getColors() const { return colors; }
+const std::vector<int64_t> &LinearScan::getSpilledNodes() const { return spilledNodes; }
+
+const ColorResult &allocateLinearScan(Function *F, LivenessResult &livenessResult,
+                                      bool splitAtCalls) {
+  auto prefix = findSpillPrefix(F);
+  auto spillInfo = F->getArena().create<SpillInfo>(prefix, F);
+
+  auto &result = *F->getArena().create<ColorResult>();
+  result.spillInfo = spillInfo;
+
+  while (true) {
+    auto &symbols = livenessResult.getSymbolTable();
+    LinearScan scan(F, livenessResult, *spillInfo);
+    if (scan.allocate()) {
+      auto &colors = scan.getColors();
+      for (int64_t id = 0; id < symbols.size(); id++)
+        if (colors[id] >= 0)
+          result.colorMap[symbols.getSymbol(id)] = (Register::ID)colors[id];
+      result.movesEliminated = countEliminatedMoves(F, result.colorMap);
+      debug(F->getName() + ": " + std::to_string(result.movesEliminated) + " moves eliminated");
+      return result;
+    }
+
+    std::unordered_set<const Variable *> varsToBeSpilled;
+    for (auto id : scan.getSpilledNodes())
+      varsToBeSpilled.insert((const Variable *)symbols.getSymbol(id));
+
+    // before spilling them everywhere, try to keep the variables in memory only across calls
+    if (splitAtCalls) {
+      LiveRangeSplitter splitter(F, livenessResult, *spillInfo);
+      if (!splitter.splitAroundCalls(varsToBeSpilled).empty()) {
+        livenessResult.updateAfterSplit();
+        continue;
+      }
+    }
+
+    std::vector<int64_t> spilledIDs;
+    for (auto var : varsToBeSpilled) {
+      result.spilledVars.insert(var);
+      spilledIDs.push_back(symbols.findID(var));
+    }
+    spillFunction(F, *spillInfo, livenessResult, varsToBeSpilled);
+    livenessResult.updateAfterSpill(spilledIDs);
+  }
+}
+
+} // namespace L2
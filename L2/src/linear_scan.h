@@ -0,0 +1,17 @@
+#pragma once
+
+#include <L2.h>
+#include <graph_colorer.h>
+#include <liveness_analyzer.h>
+
+namespace L2 {
+
+/*
+ * Assign a register to every variable of F with a linear scan over its live intervals, spilling
+ * as needed. Much cheaper than colorGraph, at the price of worse code.
+ * livenessResult must be the liveness of F, it is kept up to date with the spills. If
+ * splitAtCalls is set, the variables live across a call are first split around it.
+ */
+const ColorResult &allocateLinearScan(Function *F, LivenessResult &livenessResult,
+                                      bool splitAtCalls);
+} // namespace L2
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <L2.h>
+#include <bit_vector.h>
+#include <instruction_stream.h>
+#include <live_range_splitter.h>
+#include <liveness_analyzer.h>
+#include <loop_analyzer.h>
+#include <spiller.h>
+
+namespace L2 {
+
+LiveRangeSplitter::LiveRangeSplitter(Function *F, const LivenessResult &livenessResult,
+                                     SpillInfo &spillInfo)
+    : F{F}, livenessResult{livenessResult}, spillInfo{spillInfo},
+      loops(livenessResult.getBlockGraph()) {}
+
+void LiveRangeSplitter::prepare(const std::unordered_set<const Variable *> &candidates) {
+  auto &graph = livenessResult.getBlockGraph();
+  auto &symbols = livenessResult.getSymbolTable();
+  auto &stream = livenessResult.getStream();
+  before.assign(graph.size(), {});
+  after.assign(graph.size(), {});
+  for (int64_t b = 0; b < graph.size(); b++) {
+    before[b].resize(graph.getBlock(b)->getInstructions().size());
+    after[b].resize(graph.getBlock(b)->getInstructions().size());
+  }
+
+  candidateIDs = BitVector(symbols.size());
+  for (auto var : candidates)
+    candidateIDs.set(symbols.findID(var));
+
+  // spilling costs a memory access at each use and definition
+  splitCost.assign(symbols.size(), 0);
+  spillCost.assign(symbols.size(), 0);
+  unsplittable.assign(symbols.size(), false);
+  sites.clear();
+  std::vector<int64_t> defs(symbols.size(), 0);
+  std::vector<bool> constant(symbols.size(), false);
+  for (int64_t b = 0; b < graph.size(); b++) {
+    auto weight = loops.getFrequency(b);
+    livenessResult.scanBlockGenKill(
+        graph.getBlock(b), [&](int64_t i, const IDList &GEN, const IDList &KILL) {
+          for (auto id : GEN)
+            spillCost[id] += weight;
+          for (auto id : KILL) {
+            spillCost[id] += weight;
+            defs[id]++;
+            constant[id] = stream.getConstant(i) != nullptr;
+          }
+        });
+  }
+
+  // the spiller recomputes the variables defined once by a constant, cheaper than any split
+  for (int64_t id = 0; id < symbols.size(); id++)
+    if (defs[id] == 1 && constant[id])
+      unsplittable[id] = true;
+}
+
+void LiveRangeSplitter::addSite(SplitSite &&site, double cost) {
+  splitCost[site.id] += cost;
+  sites.push_back(std::move(site));
+}
+
+std::vector<const Variable *> LiveRangeSplitter::applySplits() {
+  auto &symbols = livenessResult.getSymbolTable();
+  std::vector<const Variable *> split;
+  std::vector<bool> selected(symbols.size(), false);
+  candidateIDs.forEach([&](int64_t id) {
+    if (!unsplittable[id] && splitCost[id] > 0 && splitCost[id] < spillCost[id]) {
+      selected[id] = true;
+      split.push_back((const Variable *)symbols.getSymbol(id));
+    }
+  });
+
+  for (auto &site : sites) {
+    if (!selected[site.id])
+      continue;
+    auto var = (const Variable *)symbols.getSymbol(site.id);
+    auto memLoc = spillInfo.getVarSpillInfo(var)->memLoc;
+    for (auto stores : site.stores)
+      stores->push_back(F->getArena().create<AssignInst>(memLoc, var));
+    for (auto loads : site.loads)
+      loads->push_back(F->getArena().create<AssignInst>(var, memLoc));
+  }
+
+  if (!split.empty())
+    rewrite();
+  return split;
+}
+
+bool LiveRangeSplitter::returnsToNextBlock(int64_t b, const Instruction *I) const {
+  auto &graph = livenessResult.getBlockGraph();
+  if (b + 1 >= graph.size() || graph.getBlock(b)->getInstructions().back() != I)
+    return false;
+  auto &preds = graph.getPredecessors(b + 1);
+  auto next = graph.getBlock(b + 1);
+  return preds.size() == 1 && preds[0] == b && !next->getInstructions().empty() &&
+         isa<LabelInst>(next->getFirstInstruction());
+}
+
+std::vector<const Instruction *> *LiveRangeSplitter::entryPoint(int64_t b) {
+  // the end of block b, before the jump or call leaving it
+  auto &instructions = livenessResult.getBlockGraph().getBlock(b)->getInstructions();
+  auto last = instructions.size() - 1;
+  auto I = instructions[last];
+  if (isa<GotoInst>(I) || isa<CondJumpInst>(I) || isa<CallInst>(I))
+    return &before[b][last];
+  return &after[b][last];
+}
+
+std::vector<const Instruction *> *LiveRangeSplitter::exitPoint(int64_t b) {
+  // the start of block b, after its label
+  auto &instructions = livenessResult.getBlockGraph().getBlock(b)->getInstructions();
+  if (isa<LabelInst>(instructions[0]))
+    return &after[b][0];
+  return &before[b][0];
+}
+
+std::vector<const Variable *>
+LiveRangeSplitter::splitAroundCalls(const std::unordered_set<const Variable *> &candidates) {
+  auto &graph = livenessResult.getBlockGraph();
+  auto &symbols = livenessResult.getSymbolTable();
+  auto &stream = livenessResult.getStream();
+  prepare(candidates);
+
+  /*
+   * The blocks are walked forward in chains, a block ending with a call being followed by the
+   * block the call returns to. Along a chain, a variable stays in memory from one call to the
+   * next if it is not used in between: the load after the first call and the store before the
+   * second one are left out. A store is also left out while the slot still holds the value.
+   */
+  std::vector<std::vector<const Instruction *> *> pendingLoad(symbols.size(), nullptr);
+  std::vector<double> pendingWeight(symbols.size(), 0);
+  std::vector<bool> synced(symbols.size(), false);
+  std::vector<int64_t> touched;
+  auto flushLoad = [&](int64_t id) {
+    if (pendingLoad[id] == nullptr)
+      return;
+    addSite({id, {}, {pendingLoad[id]}}, pendingWeight[id]);
+    pendingLoad[id] = nullptr;
+  };
+  auto endChain = [&]() {
+    for (auto id : touched) {
+      flushLoad(id);
+      synced[id] = false;
+    }
+    touched.clear();
+  };
+
+  // candidates used, defined and live across each instruction of a block
+  std::vector<std::vector<int64_t>> refs, defs, across;
+  for (int64_t b = 0; b < graph.size(); b++) {
+    auto BB = graph.getBlock(b);
+    auto n = (int64_t)BB->getInstructions().size();
+    if (b == 0 || !returnsToNextBlock(b - 1, graph.getBlock(b - 1)->getInstructions().back()))
+      endChain();
+
+    refs.assign(n, {});
+    defs.assign(n, {});
+    across.assign(n, {});
+    auto first = stream.getBlockStart(b);
+    livenessResult.scanBlockLive(
+        BB, [&](int64_t row, const BitVector &live, const IDList &GEN, const IDList &KILL) {
+          auto i = row - first;
+          for (auto id : GEN)
+            if (candidateIDs.test(id))
+              refs[i].push_back(id);
+          for (auto id : KILL)
+            if (candidateIDs.test(id)) {
+              refs[i].push_back(id);
+              defs[i].push_back(id);
+            }
+          if (stream.isCall(row))
+            live.forEach([&](int64_t id) {
+              if (candidateIDs.test(id))
+                across[i].push_back(id);
+            });
+        });
+
+    for (int64_t i = 0; i < n; i++) {
+      auto I = BB->getInstructions()[i];
+      for (auto id : refs[i])
+        flushLoad(id);
+      for (auto id : defs[i])
+        synced[id] = false;
+      if (across[i].empty())
+        continue;
+
+      // print, input and allocate return to the next instruction, functions to the label at
+      // the start of the next block unless they are called natively
+      std::vector<const Instruction *> *loads = nullptr;
+      auto loadWeight = loops.getFrequency(b);
+      if (!isa<CallInst>(I) || nativeCalls)
+        loads = &after[b][i];
+      else if (returnsToNextBlock(b, I)) {
+        loads = &after[b + 1][0];
+        loadWeight = loops.getFrequency(b + 1);
+      }
+
+      for (auto id : across[i]) {
+        if (loads == nullptr) {
+          unsplittable[id] = true;
+          continue;
+        }
+        if (pendingLoad[id] == nullptr && !synced[id])
+          addSite({id, {&before[b][i]}, {}}, loops.getFrequency(b));
+        pendingLoad[id] = loads;
+        pendingWeight[id] = loadWeight;
+        synced[id] = true;
+        touched.push_back(id);
+      }
+    }
+  }
+  endChain();
+
+  return applySplits();
+}
+
+std::vector<const Variable *>
+LiveRangeSplitter::splitAroundLoops(const std::unordered_set<const Variable *> &candidates) {
+  auto &graph = livenessResult.getBlockGraph();
+  auto &symbols = livenessResult.getSymbolTable();
+  prepare(candidates);
+
+  // symbols used or defined in each block, and the most symbols live at once in it
+  std::vector<BitVector> referenced(graph.size(), BitVector(symbols.size()));
+  std::vector<int64_t> pressure(graph.size(), 0);
+  for (int64_t b = 0; b < graph.size(); b++)
+    livenessResult.scanBlockLive(
+        graph.getBlock(b),
+        [&](int64_t i, const BitVector &live, const IDList &GEN, const IDList &KILL) {
+          for (auto id : GEN)
+            referenced[b].set(id);
+          for (auto id : KILL)
+            referenced[b].set(id);
+          pressure[b] = std::max(pressure[b], live.count());
+        });
+  auto registers = (int64_t)Register::getAllGPRegisters().size();
+
+  // headers by increasing depth, a variable split around a loop is not live in its inner loops
+  std::vector<int64_t> headers;
+  for (int64_t b = 1; b < graph.size(); b++)
+    if (loops.isLoopHeader(b))
+      headers.push_back(b);
+  std::stable_sort(headers.begin(), headers.end(), [&](int64_t a, int64_t b) {
+    return loops.getDepth(a) < loops.getDepth(b);
+  });
+
+  std::vector<BitVector> splitBodies(symbols.size());
+  BitVector live(symbols.size());
+  for (auto header : headers) {
+    auto &body = loops.getBody(header);
+    int64_t loopPressure = 0;
+    body.forEach([&](int64_t b) { loopPressure = std::max(loopPressure, pressure[b]); });
+    if (loopPressure <= registers)
+      continue;
+
+    // candidates live at the entry of the loop and not referenced in it
+    live = livenessResult.getBlockIN(graph.getBlock(header));
+    live &= candidateIDs;
+    body.forEach([&](int64_t b) { live -= referenced[b]; });
+    if (!live.any())
+      continue;
+
+    std::vector<int64_t> entries, exits;
+    for (auto pred : graph.getPredecessors(header))
+      if (!body.test(pred))
+        entries.push_back(pred);
+    auto closed = !entries.empty();
+    body.forEach([&](int64_t b) {
+      for (auto succ : graph.getSuccessors(b)) {
+        if (body.test(succ) || std::find(exits.begin(), exits.end(), succ) != exits.end())
+          continue;
+        exits.push_back(succ);
+        for (auto pred : graph.getPredecessors(succ))
+          closed = closed && body.test(pred);
+      }
+    });
+
+    if (!closed)
+      continue;
+
+    live.forEach([&](int64_t id) {
+      if (splitBodies[id].size() > 0 && splitBodies[id].test(header))
+        return;
+
+      SplitSite site{id, {}, {}};
+      double cost = 0;
+      for (auto entry : entries) {
+        site.stores.push_back(entryPoint(entry));
+        cost += loops.getFrequency(entry);
+      }
+      for (auto exit : exits)
+        if (livenessResult.getBlockIN(graph.getBlock(exit)).test(id)) {
+          site.loads.push_back(exitPoint(exit));
+          cost += loops.getFrequency(exit);
+        }
+      addSite(std::move(site), cost);
+
+      if (splitBodies[id].size() == 0)
+        splitBodies[id] = BitVector(graph.size());
+      splitBodies[id] |= body;
+    });
+  }
+
+  return applySplits();
+}
+
+void LiveRangeSplitter::rewrite() {
+  auto &basicBlocks = F->getBasicBlocks();
+  for (size_t b = 0; b < basicBlocks.size(); b++) {
+    auto BB = basicBlocks[b];
+    std::vector<const Instruction *> instructions;
+    for (size_t i = 0; i < BB->instructions.size(); i++) {
+      instructions.insert(instructions.end(), before[b][i].begin(), before[b][i].end());
+      instructions.push_back(BB->instructions[i]);
+      instructions.insert(instructions.end(), after[b][i].begin(), after[b][i].end());
+    }
+    BB->instructions = instructions;
+  }
+}
+
+} // namespace L2
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+#include <L2.h>
+#include <bit_vector.h>
+#include <liveness_analyzer.h>
+#include <loop_analyzer.h>
+#include <spiller.h>
+
+namespace L2 {
+
+/*
+ * Split the live ranges of variables at region boundaries, the part of a live range inside the
+ * region being kept in the stack slot of the variable. The variables keep their names, a store
+ * before the region and a load after it are enough to end and restart their live ranges.
+ *
+ * A candidate is only split if the copies are expected to run less often than the loads and
+ * stores spilling it everywhere would add, the blocks being weighted by their loop depth.
+ * The split functions return the variables that have been split. If there are any, the
+ * liveness of the function has to be updated with LivenessResult::updateAfterSplit.
+ */
+class LiveRangeSplitter {
+public:
+  LiveRangeSplitter(Function *F, const LivenessResult &livenessResult, SpillInfo &spillInfo);
+
+  /*
+   * Keep the candidates live across a call in memory during the call: each one is stored right
+   * before the call and loaded again where the call returns. Calls to functions return to the
+   * label following them, they are only split if that label can not be reached otherwise.
+   */
+  std::vector<const Variable *>
+  splitAroundCalls(const std::unordered_set<const Variable *> &candidates);
+
+  /*
+   * Keep the candidates live through a loop without being used in it in memory during the
+   * loop: each one is stored on the edges entering the loop and loaded again on the exits it is
+   * live at. Only the loops in which more symbols are live at once than there are registers are
+   * split, and only if none of their exits can be reached from outside of them.
+   */
+  std::vector<const Variable *>
+  splitAroundLoops(const std::unordered_set<const Variable *> &candidates);
+
+private:
+  /*
+   * Copies to insert to split the live range of one variable around one region.
+   */
+  struct SplitSite {
+    int64_t id;
+    std::vector<std::vector<const Instruction *> *> stores, loads;
+  };
+
+  Function *F;
+  const LivenessResult &livenessResult;
+  SpillInfo &spillInfo;
+  LoopResult loops;
+
+  // instructions to insert before and after each instruction of each block
+  std::vector<std::vector<std::vector<const Instruction *>>> before, after;
+
+  BitVector candidateIDs;
+  std::vector<double> splitCost, spillCost;
+  std::vector<bool> unsplittable;
+  std::vector<SplitSite> sites;
+
+  void prepare(const std::unordered_set<const Variable *> &candidates);
+  void addSite(SplitSite &&site, double cost);
+  std::vector<const Variable *> applySplits();
+
+  bool returnsToNextBlock(int64_t b, const Instruction *I) const;
+  std::vector<const Instruction *> *entryPoint(int64_t b);
+  std::vector<const Instruction *> *exitPoint(int64_t b);
+  void rewrite();
+};
+
+} // namespace L2
@@ -1,264 +1,262 @@
+#include <algorithm>
 #include <iostream>
-#include <map>
-#include <queue>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <L2.h>
+#include <bit_vector.h>
+#include <dataflow.h>
 #include <liveness_analyzer.h>
+#include <symbol_table.h>
 
 namespace L2 {
 
-class GenKillCalculator : public Visitor {
-public:
-  void visit(const Register *reg) override {
-    debug("visiting register " + reg->toStr());
-    if (reg->getID() == Register::ID::RSP)
-      return;
-    now->insert(reg);
-  }
-
-  void visit(const Variable *var) override {
-    debug("visiting variable " + var->toStr());
-    now->insert(var);
-  }
-
-  void visit(const Number *num) override {}
-  void visit(const CompareOp *op) override {}
-  void visit(const ShiftOp *op) override {}
-  void visit(const ArithOp *op) override {}
-  void visit(const SelfModOp *op) override {}
-
-  void visit(const MemoryLocation *mem) override {
-    // no matter how mem loc is accessed, the base register is always brought alive
-    auto original = now;
-    now = &GEN;
-    mem->getBase()->accept(*this);
-    now = original;
+void LivenessResult::summarizeBlock(int64_t b) {
+  // GEN holds the upward exposed uses, KILL all the definitions
+  auto &GEN = blockGEN[b], &KILL = blockKILL[b];
+  GEN.clear();
+  KILL.clear();
+  for (auto i = stream.getBlockStart(b + 1) - 1; i >= stream.getBlockStart(b); i--) {
+    for (auto id : stream.getKILL(i)) {
+      GEN.reset(id);
+      KILL.set(id);
+    }
+    for (auto id : stream.getGEN(i))
+      GEN.set(id);
   }
-  void visit(const StackLocation *stack) override {}
-  void visit(const FunctionName *name) override {}
-  void visit(const Label *label) override {}
-
-  void visit(const RetInst *inst) override {
-    GEN.insert(Register::getRegister(Register::ID::RAX));
-    auto &calleeSaved = Register::getCalleeSavedRegisters();
-    GEN.insert(calleeSaved.begin(), calleeSaved.end());
-  }
-
-  void visit(const ShiftInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getLval()->accept(*this);
-    inst->getRval()->accept(*this);
-  }
-
-  void visit(const ArithInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getLval()->accept(*this);
-    inst->getRval()->accept(*this);
-  }
-
-  void visit(const SelfModInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getLval()->accept(*this);
-  }
-
-  void visit(const AssignInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getRval()->accept(*this);
-  }
-
-  void visit(const CompareAssignInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getCmpLval()->accept(*this);
-    inst->getCmpRval()->accept(*this);
-  }
-
-  void visit(const CallInst *inst) override {
-    handleCall(inst->getArgNum()->getVal());
-    now = &GEN;
-    inst->getCallee()->accept(*this);
-  }
-
-  void visit(const PrintInst *inst) override { handleCall(1); }
-
-  void visit(const InputInst *inst) override { handleCall(0); }
-
-  void visit(const AllocateInst *inst) override { handleCall(2); }
-
-  void visit(const TupleErrorInst *inst) override { handleCall(3); }
-
-  void visit(const TensorErrorInst *inst) override { handleCall(inst->getArgNum()->getVal()); }
-
-  void visit(const SetInst *inst) override {
-    now = &KILL;
-    inst->getLval()->accept(*this);
-    now = &GEN;
-    inst->getBase()->accept(*this);
-    inst->getOffset()->accept(*this);
-  }
-  void visit(const LabelInst *inst) override {}
-
-  void visit(const GotoInst *inst) override {}
+}
 
-  void visit(const CondJumpInst *inst) override {
-    now = &GEN;
-    inst->getLval()->accept(*this);
-    inst->getRval()->accept(*this);
-  }
+std::vector<int64_t> LivenessResult::rebuildChangedBlocks() {
+  auto changedBlocks = stream.update(graph, symbols);
+  instBlock.clear();
+  cache.clear();
+  return changedBlocks;
+}
 
-  static GenKillCalculator *getInstance() {
-    if (instance == nullptr)
-      instance = new GenKillCalculator();
-    return instance;
+std::vector<int64_t> LivenessResult::updateAfterSpill(const std::vector<int64_t> &spilledIDs) {
+  auto changedBlocks = rebuildChangedBlocks();
+
+  /*
+   * The spilled variables disappear from every set. The spill temporaries are block local: each
+   * one is defined and used around a single instruction, so the IN and OUT sets of the blocks do
+   * not change otherwise.
+   */
+  auto size = symbols.size();
+  BitVector spilled(size);
+  for (auto id : spilledIDs)
+    spilled.set(id);
+  for (int64_t b = 0; b < graph.size(); b++) {
+    blockGEN[b].resize(size);
+    blockKILL[b].resize(size);
+    blockIN[b].resize(size);
+    blockOUT[b].resize(size);
+    blockIN[b] -= spilled;
+    blockOUT[b] -= spilled;
   }
+  for (auto b : changedBlocks)
+    summarizeBlock(b);
+  return changedBlocks;
+}
 
-  void doVisit(const Instruction *I) {
-    GEN.clear();
-    KILL.clear();
-    I->accept(*this);
-  }
+void LivenessResult::updateAfterElimination(std::vector<BitVector> &&IN,
+                                            std::vector<BitVector> &&OUT) {
+  for (auto b : rebuildChangedBlocks())
+    summarizeBlock(b);
+  blockIN = std::move(IN);
+  blockOUT = std::move(OUT);
+}
 
-  std::unordered_set<const Symbol *> &getGEN() { return GEN; }
-  std::unordered_set<const Symbol *> &getKILL() { return KILL; }
+void LivenessSets::buildViews() const {
+  if (viewsBuilt)
+    return;
+  GEN.forEach([&](int64_t id) { GENView.insert(symbols->getSymbol(id)); });
+  KILL.forEach([&](int64_t id) { KILLView.insert(symbols->getSymbol(id)); });
+  IN.forEach([&](int64_t id) { INView.insert(symbols->getSymbol(id)); });
+  OUT.forEach([&](int64_t id) { OUTView.insert(symbols->getSymbol(id)); });
+  viewsBuilt = true;
+}
 
-private:
-  std::unordered_set<const Symbol *> GEN, KILL, *now;
+void LivenessSets::dropViews() {
+  if (!viewsBuilt)
+    return;
+  GENView.clear();
+  KILLView.clear();
+  INView.clear();
+  OUTView.clear();
+  viewsBuilt = false;
+}
 
-  GenKillCalculator(){};
-  static GenKillCalculator *instance;
+const std::unordered_set<const Symbol *> &LivenessSets::getGEN() const {
+  buildViews();
+  return GENView;
+}
+const std::unordered_set<const Symbol *> &LivenessSets::getKILL() const {
+  buildViews();
+  return KILLView;
+}
+const std::unordered_set<const Symbol *> &LivenessSets::getIN() const {
+  buildViews();
+  return INView;
+}
+const std::unordered_set<const Symbol *> &LivenessSets::getOUT() const {
+  buildViews();
+  return OUTView;
+}
 
-  // used as a readonly buffer
-  const std::unordered_set<const Register *> &callerSaved = Register::getCallerSavedRegisters(),
-                                             &calleeSaved = Register::getCalleeSavedRegisters();
-  const std::vector<const Register *> &args = Register::getArgRegisters();
+const BitVector &LivenessSets::getGENBits() const { return GEN; }
+const BitVector &LivenessSets::getKILLBits() const { return KILL; }
+const BitVector &LivenessSets::getINBits() const { return IN; }
+const BitVector &LivenessSets::getOUTBits() const { return OUT; }
+
+void LivenessResult::prepareScan(int64_t b, LivenessSets &sets) const {
+  auto size = symbols.size();
+  sets.symbols = &symbols;
+  sets.GEN.resize(size);
+  sets.KILL.resize(size);
+  sets.IN.resize(size);
+  sets.OUT = blockOUT[b];
+}
 
-  void handleCall(int64_t argNum) {
-    KILL.insert(callerSaved.begin(), callerSaved.end());
-    for (int i = 0; i < std::min(argNum, (int64_t)6); i++)
-      GEN.insert(args[i]);
+void LivenessResult::stepScan(int64_t i, LivenessSets &sets) const {
+  // sets.OUT already holds the OUT set of instruction i
+  sets.IN = sets.OUT;
+  for (auto id : stream.getKILL(i)) {
+    sets.KILL.set(id);
+    sets.IN.reset(id);
   }
-};
-
-void calculateGenKill(const Function *F, LivenessResult &functionResult) {
-  auto &result = functionResult.result;
-  auto calculator = GenKillCalculator::getInstance();
-  for (auto I : functionResult.instBuffer) {
-    calculator->doVisit(I);
-    result[I].GEN = calculator->getGEN();
-    result[I].KILL = calculator->getKILL();
+  for (auto id : stream.getGEN(i)) {
+    sets.GEN.set(id);
+    sets.IN.set(id);
   }
+  sets.dropViews();
 }
 
-GenKillCalculator *GenKillCalculator::instance = nullptr;
-
-const std::unordered_set<const Symbol *> &LivenessSets::getGEN() const { return GEN; }
-const std::unordered_set<const Symbol *> &LivenessSets::getKILL() const { return KILL; }
-const std::unordered_set<const Symbol *> &LivenessSets::getIN() const { return IN; }
-const std::unordered_set<const Symbol *> &LivenessSets::getOUT() const { return OUT; }
+void LivenessResult::finishStep(int64_t i, LivenessSets &sets) const {
+  for (auto id : stream.getKILL(i))
+    sets.KILL.reset(id);
+  for (auto id : stream.getGEN(i))
+    sets.GEN.reset(id);
+  // the IN set of this instruction is the OUT set of the previous one
+  std::swap(sets.IN, sets.OUT);
+}
 
 void LivenessResult::dump() const {
-  std::cout << "(" << std::endl << "(in" << std::endl;
-  for (auto I : instBuffer) {
-    auto &IN = result.at(I).getIN();
-    std::cout << "(";
-
-    for (auto symbol : IN)
-      std::cout << symbol->toStr() << " ";
-
-    std::cout << ")" << std::endl;
+  std::vector<std::string> INs, OUTs;
+  for (int64_t b = 0; b < graph.size(); b++) {
+    std::vector<std::string> blockINs, blockOUTs;
+    scanBlockAt(b, [&](const Instruction *I, const LivenessSets &sets) {
+      std::string in, out;
+      sets.IN.forEach([&](int64_t id) { in += symbols.getSymbol(id)->toStr() + " "; });
+      sets.OUT.forEach([&](int64_t id) { out += symbols.getSymbol(id)->toStr() + " "; });
+      blockINs.push_back(in);
+      blockOUTs.push_back(out);
+    });
+    INs.insert(INs.end(), blockINs.rbegin(), blockINs.rend());
+    OUTs.insert(OUTs.end(), blockOUTs.rbegin(), blockOUTs.rend());
   }
 
-  std::cout << ")" << std::endl << std::endl << "(out" << std::endl;
-
-  for (auto I : instBuffer) {
-    auto &OUT = result.at(I).getOUT();
-    std::cout << "(";
+  std::cout << "(" << std::endl << "(in" << std::endl;
+  for (auto &IN : INs)
+    std::cout << "(" << IN << ")" << std::endl;
 
-    for (auto symbol : OUT)
-      std::cout << symbol->toStr() << " ";
+  std::cout << ")" << std::endl << std::endl << "(out" << std::endl;
 
-    std::cout << ")" << std::endl;
-  }
+  for (auto &OUT : OUTs)
+    std::cout << "(" << OUT << ")" << std::endl;
 
   std::cout << ")" << std::endl << std::endl << ")" << std::endl;
 }
 
+const SymbolTable &LivenessResult::getSymbolTable() const { return symbols; }
+
 const LivenessSets &LivenessResult::getLivenessSets(const Instruction *I) const {
-  return result.at(I);
+  auto it = cache.find(I);
+  if (it != cache.end())
+    return it->second;
+
+  if (instBlock.empty())
+    for (int64_t b = 0; b < graph.size(); b++)
+      for (auto i = stream.getBlockStart(b); i < stream.getBlockStart(b + 1); i++)
+        instBlock[stream.getInstruction(i)] = b;
+
+  // reconstruct the sets of all the instructions in the block holding I
+  scanBlockAt(instBlock.at(I), [&](const Instruction *J, const LivenessSets &sets) {
+    auto &cached = cache[J];
+    cached.symbols = &symbols;
+    cached.GEN = sets.GEN;
+    cached.KILL = sets.KILL;
+    cached.IN = sets.IN;
+    cached.OUT = sets.OUT;
+  });
+  return cache.at(I);
 }
 
-bool setEqual(const std::unordered_set<const Symbol *> &a,
-              const std::unordered_set<const Symbol *> &b) {
-  if (a.size() != b.size())
-    return false;
-
-  for (auto var : a)
-    if (b.find(var) == b.end())
-      return false;
-
-  return true;
+const BitVector &LivenessResult::getBlockIN(const BasicBlock *BB) const {
+  return blockIN[graph.getIndex(BB)];
 }
-
-bool analyzeInBB(const BasicBlock *BB, LivenessResult &functionResult, bool visited) {
-  std::unordered_set<const Symbol *> buffer;
-  auto &result = functionResult.result;
-  for (auto succ : BB->getSuccessors()) {
-    auto &succIN = result[succ->getFirstInstruction()].IN;
-    buffer.insert(succIN.begin(), succIN.end());
-  }
-
-  if (visited && setEqual(buffer, result[BB->getTerminator()].OUT))
-    return false;
-
-  for (auto pI = BB->getInstructions().rbegin(); pI != BB->getInstructions().rend(); pI++) {
-    auto I = *pI;
-    result[I].OUT = buffer;
-    auto &GEN = result[I].GEN, &KILL = result[I].KILL;
-    for (auto var : KILL)
-      buffer.erase(var);
-    buffer.insert(GEN.begin(), GEN.end());
-    result[I].IN = buffer;
-  }
-  return true;
+const BitVector &LivenessResult::getBlockOUT(const BasicBlock *BB) const {
+  return blockOUT[graph.getIndex(BB)];
 }
+const BlockGraph &LivenessResult::getBlockGraph() const { return graph; }
+const InstructionStream &LivenessResult::getStream() const { return stream; }
 
-const LivenessResult &analyzeLiveness(const Function *F) {
-  auto livenessResult = new LivenessResult();
-
-  // first, initialize the instBuffer
-  for (auto BB : F->getBasicBlocks())
-    for (auto I : BB->getInstructions())
-      livenessResult->instBuffer.push_back(I);
+LivenessResult::LivenessResult(const Function *F) : graph{F} {}
 
-  calculateGenKill(F, *livenessResult);
+/*
+ * IN = GEN U (OUT - KILL) on the block summaries.
+ */
+class LivenessTransfer {
+public:
+  LivenessTransfer(const std::vector<BitVector> &GEN, const std::vector<BitVector> &KILL)
+      : GEN{GEN}, KILL{KILL} {}
 
-  std::queue<BasicBlock *> workq;
-  std::map<BasicBlock *, bool> visited;
-  for (auto pB = F->getBasicBlocks().rbegin(); pB != F->getBasicBlocks().rend(); pB++)
-    workq.push(*pB);
+  void operator()(int64_t b, const BitVector &OUT, BitVector &IN) {
+    IN = OUT;
+    IN -= KILL[b];
+    IN |= GEN[b];
+  }
 
-  while (!workq.empty()) {
-    auto BB = workq.front();
-    workq.pop();
+private:
+  const std::vector<BitVector> &GEN, &KILL;
+};
 
-    if (analyzeInBB(BB, *livenessResult, visited[BB]))
-      for (auto pred : BB->getPredecessors())
-        workq.push(pred);
+void LivenessResult::solve() {
+  LivenessTransfer transfer(blockGEN, blockKILL);
+  DataflowSolver<Direction::BACKWARD, UnionMeet, LivenessTransfer> solver(graph, symbols.size(),
+                                                                          transfer);
+  solver.solve();
+  blockIN = std::move(solver.getIN());
+  blockOUT = std::move(solver.getOUT());
+}
 
-    visited[BB] = true;
+void LivenessResult::updateAfterSplit() {
+  auto changedBlocks = rebuildChangedBlocks();
+  auto size = symbols.size();
+  for (int64_t b = 0; b < graph.size(); b++) {
+    blockGEN[b].resize(size);
+    blockKILL[b].resize(size);
   }
+  for (auto b : changedBlocks)
+    summarizeBlock(b);
+  solve();
+}
 
+LivenessResult &analyzeLiveness(const Function *F) {
+  auto livenessResult = F->getArena().create<LivenessResult>(F);
+  livenessResult->stream.build(livenessResult->graph, livenessResult->symbols);
+
+  // the symbols are numbered while lowering, so the bit vectors can only be sized afterwards
+  auto &graph = livenessResult->graph;
+  auto size = livenessResult->symbols.size();
+  livenessResult->blockGEN.assign(graph.size(), BitVector(size));
+  livenessResult->blockKILL.assign(graph.size(), BitVector(size));
+  for (int64_t b = 0; b < graph.size(); b++)
+    livenessResult->summarizeBlock(b);
+  livenessResult->solve();
   return *livenessResult;
 }
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <L2.h>
+#include <bit_vector.h>
+#include <dataflow.h>
+#include <instruction_stream.h>
+#include <symbol_table.h>
 
-#include <map>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -12,37 +16,150 @@ class LivenessResult;
 
 class LivenessSets {
 public:
+  /*
+   * Set views of the bit vectors, built on first access.
+   */
   const std::unordered_set<const Symbol *> &getGEN() const;
   const std::unordered_set<const Symbol *> &getKILL() const;
   const std::unordered_set<const Symbol *> &getIN() const;
   const std::unordered_set<const Symbol *> &getOUT() const;
 
+  /*
+   * Bit vectors indexed by the symbol IDs of the function's SymbolTable.
+   */
+  const BitVector &getGENBits() const;
+  const BitVector &getKILLBits() const;
+  const BitVector &getINBits() const;
+  const BitVector &getOUTBits() const;
+
 private:
-  std::unordered_set<const Symbol *> GEN, KILL, IN, OUT;
+  BitVector GEN, KILL, IN, OUT;
+  const SymbolTable *symbols;
+
+  mutable bool viewsBuilt = false;
+  mutable std::unordered_set<const Symbol *> GENView, KILLView, INView, OUTView;
+  void buildViews() const;
+  void dropViews();
 
-  friend const LivenessResult &analyzeLiveness(const Function *F);
-  friend bool analyzeInBB(const BasicBlock *BB, LivenessResult &functionResult, bool visited);
-  friend void calculateGenKill(const Function *F, LivenessResult &functionResult);
+  friend class LivenessResult;
 };
 
+/*
+ * Liveness of a function.
+ * Only the block level sets are kept, the sets of a single instruction are reconstructed by a
+ * backward scan over its basic block in the instruction stream of the function.
+ */
 class LivenessResult {
 public:
-  LivenessResult() = default;
+  LivenessResult(const Function *F);
   void dump() const;
+  const SymbolTable &getSymbolTable() const;
+
+  /*
+   * Walk the instructions of BB from the last to the first one, calling f(I, sets) with the
+   * liveness sets of each instruction. The sets are only valid during the call.
+   */
+  template <typename F> void scanBlock(const BasicBlock *BB, F f) const {
+    scanBlockAt(graph.getIndex(BB), f);
+  }
+
+  /*
+   * Walk the instructions of BB from the last to the first one, calling f(i, GEN, KILL) with the
+   * row i of the instruction in the stream and the IDs of the symbols it generates and kills
+   * (possibly with duplicates).
+   */
+  template <typename F> void scanBlockGenKill(const BasicBlock *BB, F f) const {
+    auto b = graph.getIndex(BB);
+    for (auto i = stream.getBlockStart(b + 1) - 1; i >= stream.getBlockStart(b); i--)
+      f(i, stream.getGEN(i), stream.getKILL(i));
+  }
+
+  /*
+   * Cheaper variant of scanBlock keeping only the live set: f(i, live, GEN, KILL) is called with
+   * live holding the OUT set of row i, and GEN / KILL as for scanBlockGenKill. The live set is
+   * updated in place after each call.
+   */
+  template <typename F> void scanBlockLive(const BasicBlock *BB, F f) const {
+    BitVector live = blockOUT[graph.getIndex(BB)];
+    scanBlockGenKill(BB, [&](int64_t i, const IDList &GEN, const IDList &KILL) {
+      f(i, (const BitVector &)live, GEN, KILL);
+      for (auto id : KILL)
+        live.reset(id);
+      for (auto id : GEN)
+        live.set(id);
+    });
+  }
+
+  /*
+   * Liveness sets of a single instruction.
+   * The sets of the whole basic block are reconstructed and cached on first access.
+   */
   const LivenessSets &getLivenessSets(const Instruction *I) const;
 
+  const BitVector &getBlockIN(const BasicBlock *BB) const;
+  const BitVector &getBlockOUT(const BasicBlock *BB) const;
+  const BlockGraph &getBlockGraph() const;
+  const InstructionStream &getStream() const;
+
+  /*
+   * Patch the result after the spiller rewrote the function, instead of analyzing it again.
+   * Only the blocks whose instructions changed are visited again, the spilled variables are
+   * dropped from every set. Returns the indices of the changed blocks.
+   */
+  std::vector<int64_t> updateAfterSpill(const std::vector<int64_t> &spilledIDs);
+
+  /*
+   * Patch the result after dead instructions have been removed, IN and OUT being the block sets
+   * of the function without them.
+   */
+  void updateAfterElimination(std::vector<BitVector> &&IN, std::vector<BitVector> &&OUT);
+
+  /*
+   * Update the result after copies have been inserted to split live ranges. The blocks whose
+   * instructions changed are visited again and the block sets are solved again.
+   */
+  void updateAfterSplit();
+
 private:
-  std::map<const Instruction *, LivenessSets> result;
-  std::vector<const Instruction *> instBuffer;
+  SymbolTable symbols;
+  BlockGraph graph;
+  InstructionStream stream;
+
+  // block level sets
+  std::vector<BitVector> blockGEN, blockKILL, blockIN, blockOUT;
+
+  mutable std::unordered_map<const Instruction *, int64_t> instBlock;
+  mutable std::unordered_map<const Instruction *, LivenessSets> cache;
+
+  template <typename F> void scanBlockAt(int64_t b, F f) const {
+    LivenessSets sets;
+    prepareScan(b, sets);
+    for (auto i = stream.getBlockStart(b + 1) - 1; i >= stream.getBlockStart(b); i--) {
+      stepScan(i, sets);
+      f(stream.getInstruction(i), (const LivenessSets &)sets);
+      finishStep(i, sets);
+    }
+  }
+
+  void prepareScan(int64_t b, LivenessSets &sets) const;
+  void stepScan(int64_t i, LivenessSets &sets) const;
+  void finishStep(int64_t i, LivenessSets &sets) const;
+
+  void summarizeBlock(int64_t b);
+  void solve();
+
+  /*
+   * Lower again the blocks whose instructions changed.
+   * Returns the indices of the changed blocks, their summaries still have to be recomputed.
+   */
+  std::vector<int64_t> rebuildChangedBlocks();
 
   LivenessResult &operator=(const LivenessResult &) = delete;
   LivenessResult(const LivenessResult &) = delete;
 
-  friend const LivenessResult &analyzeLiveness(const Function *F);
-  friend bool analyzeInBB(const BasicBlock *BB, LivenessResult &functionResult, bool visited);
-  friend void calculateGenKill(const Function *F, LivenessResult &functionResult);
+  friend LivenessResult &analyzeLiveness(const Function *F);
 };
 
-const LivenessResult &analyzeLiveness(const Function *F);
+LivenessResult &analyzeLiveness(const Function *F);
 
-} // namespace L2
\ No newline at end of file
+} // namespace L2
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <L2.h>
+#include <dataflow.h>
+#include <loop_analyzer.h>
+
+namespace L2 {
+
+class DominatorTransfer {
+public:
+  void operator()(int64_t b, const BitVector &IN, BitVector &OUT) {
+    // the entry block may be a jump target, nothing but itself dominates it
+    if (b == 0)
+      OUT.clear();
+    else
+      OUT = IN;
+    OUT.set(b);
+  }
+};
+
+LoopResult::LoopResult(const BlockGraph &graph) {
+  auto n = graph.size();
+  depths.resize(n, 0);
+  headers.resize(n, false);
+  if (n == 0)
+    return;
+
+  DominatorTransfer transfer;
+  DataflowSolver<Direction::FORWARD, IntersectMeet, DominatorTransfer> solver(graph, n, transfer);
+  solver.solve();
+  dominators = std::move(solver.getOUT());
+
+  // blocks reachable from the entry, edges out of the others are ignored
+  std::vector<bool> reachable(n, false);
+  std::vector<int64_t> stack = {0};
+  reachable[0] = true;
+  while (!stack.empty()) {
+    auto b = stack.back();
+    stack.pop_back();
+    for (auto succ : graph.getSuccessors(b))
+      if (!reachable[succ]) {
+        reachable[succ] = true;
+        stack.push_back(succ);
+      }
+  }
+
+  // body of the loop of each header
+  bodies.resize(n);
+  for (int64_t tail = 0; tail < n; tail++) {
+    if (!reachable[tail])
+      continue;
+    for (auto header : graph.getSuccessors(tail)) {
+      if (!dominators[tail].test(header))
+        continue;
+
+      auto &body = bodies[header];
+      if (!headers[header]) {
+        headers[header] = true;
+        body.resize(n);
+        body.set(header);
+      }
+      if (body.test(tail))
+        continue;
+      body.set(tail);
+      stack = {tail};
+      while (!stack.empty()) {
+        auto b = stack.back();
+        stack.pop_back();
+        for (auto pred : graph.getPredecessors(b))
+          if (reachable[pred] && !body.test(pred)) {
+            body.set(pred);
+            stack.push_back(pred);
+          }
+      }
+    }
+  }
+
+  for (int64_t header = 0; header < n; header++)
+    if (headers[header])
+      bodies[header].forEach([&](int64_t b) { depths[b]++; });
+}
+
+int64_t LoopResult::getDepth(int64_t b) const { return depths[b]; }
+
+// deeper loops do not make a block run any more often
+const static int64_t maxLoopDepth = 8;
+
+double LoopResult::getFrequency(int64_t b) const {
+  return std::pow(10.0, std::min(depths[b], maxLoopDepth));
+}
+
+bool LoopResult::isLoopHeader(int64_t b) const { return headers[b]; }
+
+const BitVector &LoopResult::getBody(int64_t header) const { return bodies[header]; }
+
+const BitVector &LoopResult::getDominators(int64_t b) const { return dominators[b]; }
+
+} // namespace L2
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <L2.h>
+#include <bit_vector.h>
+#include <dataflow.h>
+
+namespace L2 {
+
+/*
+ * Natural loops of a function.
+ * A back edge is an edge whose target dominates its source, the loop of a back edge is its target
+ * (the header) plus every block reaching the source without passing through the header. Loops
+ * sharing a header are merged.
+ */
+class LoopResult {
+public:
+  LoopResult(const BlockGraph &graph);
+
+  /*
+   * Number of loops containing block b, 0 outside of any loop.
+   */
+  int64_t getDepth(int64_t b) const;
+
+  /*
+   * Estimated execution frequency of block b, 10 to its loop depth.
+   */
+  double getFrequency(int64_t b) const;
+  bool isLoopHeader(int64_t b) const;
+
+  /*
+   * Blocks of the loop of header, empty if it is not a loop header.
+   */
+  const BitVector &getBody(int64_t header) const;
+
+  /*
+   * Blocks dominating b, including b itself. Blocks not reachable from the entry are dominated
+   * by every block.
+   */
+  const BitVector &getDominators(int64_t b) const;
+
+private:
+  std::vector<BitVector> dominators, bodies;
+  std::vector<int64_t> depths;
+  std::vector<bool> headers;
+};
+
+} // namespace L2
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <utility>
 #include <vector>
 
 #include <tao/pegtl.hpp>
@@ -38,6 +39,13 @@ private:
  */
 ItemStack itemStack;
 
+/*
+ * Items, instructions and blocks are allocated in the arena of the function being parsed.
+ */
+template <typename T, typename... Args> T *create(Program &P, Args &&...args) {
+  return P.getCurrFunction()->getArena().create<T>(std::forward<Args>(args)...);
+}
+
 /*
  * Grammar rules from now on.
  */
@@ -249,7 +257,7 @@ template <typename Rule> struct action : nothing<Rule> {};
 
 template <> struct action<callee_func> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto n = new FunctionName(in.string());
+    auto n = create<FunctionName>(P, in.string());
     itemStack.push(n);
   }
 };
@@ -301,7 +309,7 @@ template <> struct action<spill_prefix> {
 
 template <> struct action<N> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto n = new Number(std::stoll(in.string()));
+    auto n = P.getCurrFunction()->getNumber(std::stoll(in.string()));
     itemStack.push(n);
   }
 };
@@ -320,40 +328,40 @@ template <> struct action<M> {
     if (offset % 8 != 0)
       throw parse_error("Offset number must be a multiple of 8.", in);
 
-    auto n = new Number(offset);
+    auto n = P.getCurrFunction()->getNumber(offset);
     itemStack.push(n);
   }
 };
 
 template <> struct action<F> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto n = new Number(std::stoll(in.string()));
+    auto n = P.getCurrFunction()->getNumber(std::stoll(in.string()));
     itemStack.push(n);
   }
 };
 
 template <> struct action<E> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto n = new Number(std::stoll(in.string()));
+    auto n = P.getCurrFunction()->getNumber(std::stoll(in.string()));
     itemStack.push(n);
   }
 };
 
 template <> struct action<ret> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto I = new RetInst();
+    auto I = create<RetInst>(P);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
 
     // next instruction is in a new BB, but is not a successor of currBB
-    auto newBB = new BasicBlock();
+    auto newBB = create<BasicBlock>(P);
     P.getCurrFunction()->addBasicBlock(newBB);
   }
 };
 
 template <> struct action<label> {
   template <typename Input> static void apply(const Input &in, Program &P) {
-    auto l = new Label(in.string());
+    auto l = create<Label>(P, in.string());
     itemStack.push(l);
   }
 };
@@ -495,7 +503,7 @@ template <> struct action<mem_loc> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     auto offset = (Number *)itemStack.pop();
     auto base = (Symbol *)itemStack.pop();
-    auto m = new MemoryLocation(base, offset);
+    auto m = P.getCurrFunction()->getMemoryLocation(base, offset);
     itemStack.push(m);
   }
 };
@@ -504,7 +512,7 @@ template <> struct action<stack_loc> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing stack_loc");
     auto offset = (Number *)itemStack.pop();
-    auto s = new StackLocation(offset);
+    auto s = P.getCurrFunction()->getStackLocation(offset);
     itemStack.push(s);
   }
 };
@@ -515,7 +523,7 @@ template <> struct action<shift_inst> {
     auto rval = (Value *)itemStack.pop();
     auto op = (ShiftOp *)itemStack.pop();
     auto lval = (Symbol *)itemStack.pop();
-    auto I = new ShiftInst(op, lval, rval);
+    auto I = create<ShiftInst>(P, op, lval, rval);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -527,7 +535,7 @@ template <> struct action<arith_inst> {
     auto rval = itemStack.pop();
     auto op = (ArithOp *)itemStack.pop();
     auto lval = itemStack.pop();
-    auto I = new ArithInst(op, lval, rval);
+    auto I = create<ArithInst>(P, op, lval, rval);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -538,7 +546,7 @@ template <> struct action<self_mod_inst> {
     debug("parsing self_mod_inst");
     auto op = (SelfModOp *)itemStack.pop();
     auto lval = (Symbol *)itemStack.pop();
-    auto I = new SelfModInst(op, lval);
+    auto I = create<SelfModInst>(P, op, lval);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -549,7 +557,7 @@ template <> struct action<norm_assign_inst> {
     debug("parsing norm_assign_inst");
     auto rval = itemStack.pop();
     auto lval = itemStack.pop();
-    auto I = new AssignInst(lval, rval);
+    auto I = create<AssignInst>(P, lval, rval);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -562,7 +570,7 @@ template <> struct action<cmp_assign_inst> {
     auto op = (CompareOp *)itemStack.pop();
     auto cmpLval = (Value *)itemStack.pop();
     auto lval = (Symbol *)itemStack.pop();
-    auto I = new CompareAssignInst(lval, op, cmpLval, cmpRval);
+    auto I = create<CompareAssignInst>(P, lval, op, cmpLval, cmpRval);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -573,7 +581,7 @@ template <> struct action<call_inst> {
     debug("parsing call_inst");
     auto argNum = (Number *)itemStack.pop();
     auto callee = itemStack.pop();
-    auto I = new CallInst(callee, argNum);
+    auto I = create<CallInst>(P, callee, argNum);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -582,7 +590,7 @@ template <> struct action<call_inst> {
 template <> struct action<print_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing print_inst");
-    auto I = new PrintInst();
+    auto I = create<PrintInst>(P);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -591,7 +599,7 @@ template <> struct action<print_inst> {
 template <> struct action<input_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing input_inst");
-    auto I = new InputInst();
+    auto I = create<InputInst>(P);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -600,7 +608,7 @@ template <> struct action<input_inst> {
 template <> struct action<allocate_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing allocate_inst");
-    auto I = new AllocateInst();
+    auto I = create<AllocateInst>(P);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -609,12 +617,12 @@ template <> struct action<allocate_inst> {
 template <> struct action<tuple_error_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing tuple_error_inst");
-    auto I = new TupleErrorInst();
+    auto I = create<TupleErrorInst>(P);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
 
     // act like return, new BB
-    auto newBB = new BasicBlock();
+    auto newBB = create<BasicBlock>(P);
     P.getCurrFunction()->addBasicBlock(newBB);
   }
 };
@@ -623,12 +631,12 @@ template <> struct action<tensor_error_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing tensor_error_inst");
     auto number = (Number *)itemStack.pop();
-    auto I = new TensorErrorInst(number);
+    auto I = create<TensorErrorInst>(P, number);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
 
     // act like return, new BB
-    auto newBB = new BasicBlock();
+    auto newBB = create<BasicBlock>(P);
     P.getCurrFunction()->addBasicBlock(newBB);
   }
 };
@@ -640,7 +648,7 @@ template <> struct action<set_inst> {
     auto offset = (Symbol *)itemStack.pop();
     auto base = (Symbol *)itemStack.pop();
     auto lval = (Symbol *)itemStack.pop();
-    auto I = new SetInst(lval, base, offset, scalar);
+    auto I = create<SetInst>(P, lval, base, offset, scalar);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
   }
@@ -649,14 +657,14 @@ template <> struct action<set_inst> {
 template <> struct action<label_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing label_inst");
-    auto label = new Label(in.string());
-    auto I = new LabelInst(label);
+    auto label = create<Label>(P, in.string());
+    auto I = create<LabelInst>(P, label);
 
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
 
     if (!currBB->getInstructions().empty()) {
       // last instruction is not goto or cjump
-      auto newBB = new BasicBlock();
+      auto newBB = create<BasicBlock>(P);
       newBB->addPredecessor(currBB);
       currBB->addSuccessor(newBB);
       P.getCurrFunction()->addBasicBlock(newBB);
@@ -671,12 +679,12 @@ template <> struct action<goto_inst> {
   template <typename Input> static void apply(const Input &in, Program &P) {
     debug("parsing goto_inst");
     auto label = (Label *)itemStack.pop();
-    auto I = new GotoInst(label);
+    auto I = create<GotoInst>(P, label);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
 
     // next instruction is in a new basic block
-    auto newBB = new BasicBlock();
+    auto newBB = create<BasicBlock>(P);
     P.getCurrFunction()->addBasicBlock(newBB);
   }
 };
@@ -688,12 +696,12 @@ template <> struct action<cjump_inst> {
     auto rval = (Value *)itemStack.pop();
     auto op = (CompareOp *)itemStack.pop();
     auto lval = (Value *)itemStack.pop();
-    auto I = new CondJumpInst(op, lval, rval, label);
+    auto I = create<CondJumpInst>(P, op, lval, rval, label);
     auto currBB = P.getCurrFunction()->getCurrBasicBlock();
     currBB->addInstruction(I);
 
     // next instruction is in a new BB, and is a successor of currBB
-    auto newBB = new BasicBlock();
+    auto newBB = create<BasicBlock>(P);
     newBB->addPredecessor(currBB);
     currBB->addSuccessor(newBB);
     P.getCurrFunction()->addBasicBlock(newBB);
@@ -715,17 +723,17 @@ void linkBasicBlocks(Function *F) {
   // find all basic blocks that starts with a label
   // these BBs may have predecessors that are not linked yet
   for (auto &BB : F->getBasicBlocks())
-    if (auto inst = dynamic_cast<const LabelInst *>(BB->getFirstInstruction()))
+    if (auto inst = dyn_cast<LabelInst>(BB->getFirstInstruction()))
       labelToBB[inst->getLabel()->getName()] = BB;
 
   // link all basic blocks
   for (auto &BB : F->getBasicBlocks()) {
-    if (auto inst = dynamic_cast<const GotoInst *>(BB->getTerminator())) {
+    if (auto inst = dyn_cast<GotoInst>(BB->getTerminator())) {
       auto label = inst->getLabel();
       auto targetBB = labelToBB[label->getName()];
       BB->addSuccessor(targetBB);
       targetBB->addPredecessor(BB);
-    } else if (auto inst = dynamic_cast<const CondJumpInst *>(BB->getTerminator())) {
+    } else if (auto inst = dyn_cast<CondJumpInst>(BB->getTerminator())) {
       auto label = inst->getLabel();
       auto targetBB = labelToBB[label->getName()];
       BB->addSuccessor(targetBB);
@@ -1,7 +1,13 @@
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <L2.h>
+#include <instruction_stream.h>
 #include <liveness_analyzer.h>
 #include <spiller.h>
 
@@ -15,8 +21,8 @@ void FunctionToSpill::setSpilledVar(const Variable *spilledVar) { this->spilledV
 std::string FunctionToSpill::getSpillPrefix() const { return spillPrefix; }
 void FunctionToSpill::setSpillPrefix(std::string spillPrefix) { this->spillPrefix = spillPrefix; }
 
-SpillInfo::SpillInfo(std::string spillPrefix)
-    : spillPrefix(spillPrefix), spillCount(0), nextPostfix(0) {}
+SpillInfo::SpillInfo(std::string spillPrefix, Function *F)
+    : spillPrefix(spillPrefix), F(F), spillCount(0), nextPostfix(0) {}
 
 std::string SpillInfo::consumeName() { return spillPrefix + std::to_string(nextPostfix++); }
 
@@ -24,40 +30,62 @@ bool SpillInfo::isSpilled(const Variable *var) const {
   return !var->getName().compare(0, spillPrefix.size(), spillPrefix);
 }
 
+int64_t SpillInfo::findSlot(const Variable *var) {
+  auto known = conflictsKnown.count(var) > 0;
+  if (known) {
+    // first fit among the slots not used by a conflicting variable
+    std::vector<bool> blocked(spillCount, false);
+    for (auto other : conflicts[var]) {
+      auto it = slotOf.find(other);
+      if (it != slotOf.end())
+        blocked[it->second] = true;
+    }
+    for (int64_t slot = 0; slot < spillCount; slot++)
+      if (sharable[slot] && !blocked[slot])
+        return slot;
+  }
+
+  slotLocations.push_back(
+      F->getMemoryLocation(Register::getRegister(Register::ID::RSP), F->getNumber(8 * spillCount)));
+  sharable.push_back(known);
+  return spillCount++;
+}
+
 VarSpillInfo *SpillInfo::getVarSpillInfo(const Variable *var) {
   if (varSpillInfos.find(var) == varSpillInfos.end()) {
-    varSpillInfos[var].memLoc =
-        new MemoryLocation(Register::getRegister(Register::ID::RSP), new Number(8 * spillCount));
-    spillCount++;
+    auto slot = findSlot(var);
+    slotOf[var] = slot;
+    varSpillInfos[var].memLoc = slotLocations[slot];
   }
   return &varSpillInfos[var];
 }
 
+void SpillInfo::setConflicts(const Variable *var,
+                             const std::vector<const Variable *> &varConflicts) {
+  conflictsKnown.insert(var);
+  for (auto other : varConflicts) {
+    conflicts[var].push_back(other);
+    conflicts[other].push_back(var);
+  }
+}
+
+void SpillInfo::setRematerialization(const Variable *var, const Item *value) {
+  varSpillInfos[var].remat = value;
+}
+
 int64_t SpillInfo::getSpillCount() const { return spillCount; }
 
 void SpillInfo::dump() const {
   std::cout << "spill info:" << std::endl;
   for (auto &[var, spillInfo] : varSpillInfos)
-    std::cout << var->toStr() << " " << spillInfo.memLoc->toStr() << std::endl;
-}
-
-std::unordered_set<const Variable *> getIntersect(const std::unordered_set<const Variable *> &set1,
-                                                  const std::unordered_set<const Symbol *> &set2) {
-  std::unordered_set<const Variable *> result;
-  for (auto var : set1)
-    if (set2.find(var) != set2.end())
-      result.insert(var);
-
-  return result;
+    std::cout << var->toStr() << " "
+              << (spillInfo.remat ? spillInfo.remat->toStr() : spillInfo.memLoc->toStr())
+              << std::endl;
 }
 
 class Spiller : Visitor {
 public:
-  static Spiller *getInstance() {
-    if (!instance)
-      instance = new Spiller();
-    return instance;
-  }
+  Spiller() = default;
 
   // when a item is visited, spill every item possible that equals to spilledVar
   // then store the updated version in buffer
@@ -89,7 +117,7 @@ public:
   void visit(const MemoryLocation *mem) override {
     mem->getBase()->accept(*this);
     auto base = (Symbol *)spilledItem;
-    spilledItem = new MemoryLocation(base, mem->getOffset());
+    spilledItem = F->getMemoryLocation(base, mem->getOffset());
   }
 
   void visit(const StackLocation *stack) override { spilledItem = stack; }
@@ -108,7 +136,7 @@ public:
     auto lval = (Symbol *)spilledItem;
     inst->getRval()->accept(*this);
     auto rval = (Value *)spilledItem;
-    spilledInst = new ShiftInst(inst->getOp(), lval, rval);
+    spilledInst = arena->create<ShiftInst>(inst->getOp(), lval, rval);
   }
 
   void visit(const ArithInst *inst) override {
@@ -116,13 +144,13 @@ public:
     auto lval = (Symbol *)spilledItem;
     inst->getRval()->accept(*this);
     auto rval = (Value *)spilledItem;
-    spilledInst = new ArithInst(inst->getOp(), lval, rval);
+    spilledInst = arena->create<ArithInst>(inst->getOp(), lval, rval);
   }
 
   void visit(const SelfModInst *inst) override {
     inst->getLval()->accept(*this);
     auto lval = (Symbol *)spilledItem;
-    spilledInst = new SelfModInst(inst->getOp(), lval);
+    spilledInst = arena->create<SelfModInst>(inst->getOp(), lval);
   }
 
   void visit(const AssignInst *inst) override {
@@ -130,7 +158,7 @@ public:
     auto lval = (Symbol *)spilledItem;
     inst->getRval()->accept(*this);
     auto rval = (Value *)spilledItem;
-    spilledInst = new AssignInst(lval, rval);
+    spilledInst = arena->create<AssignInst>(lval, rval);
   }
 
   void visit(const CompareAssignInst *inst) override {
@@ -140,13 +168,13 @@ public:
     auto cmpLval = (Value *)spilledItem;
     inst->getCmpRval()->accept(*this);
     auto cmpRval = (Value *)spilledItem;
-    spilledInst = new CompareAssignInst(lval, inst->getOp(), cmpLval, cmpRval);
+    spilledInst = arena->create<CompareAssignInst>(lval, inst->getOp(), cmpLval, cmpRval);
   }
 
   void visit(const CallInst *inst) override {
     inst->getCallee()->accept(*this);
     auto callee = (Item *)spilledItem;
-    spilledInst = new CallInst(callee, inst->getArgNum());
+    spilledInst = arena->create<CallInst>(callee, inst->getArgNum());
   }
 
   void visit(const PrintInst *inst) override {
@@ -172,7 +200,7 @@ public:
     auto base = (Symbol *)spilledItem;
     inst->getOffset()->accept(*this);
     auto offset = (Symbol *)spilledItem;
-    spilledInst = new SetInst(lval, base, offset, inst->getScalar());
+    spilledInst = arena->create<SetInst>(lval, base, offset, inst->getScalar());
   }
 
   void visit(const LabelInst *inst) override {
@@ -187,35 +215,82 @@ public:
     auto lval = (Value *)spilledItem;
     inst->getRval()->accept(*this);
     auto rval = (Value *)spilledItem;
-    spilledInst = new CondJumpInst(inst->getOp(), lval, rval, inst->getLabel());
+    spilledInst = arena->create<CondJumpInst>(inst->getOp(), lval, rval, inst->getLabel());
   }
 
-  void doVisit(const Instruction *I) {
+  // collect the spilled variables generated and killed by each instruction of BB
+  void collectOccurrences(const BasicBlock *BB) {
+    occurrences.clear();
+    auto &stream = result->getStream();
+    auto b = result->getBlockGraph().getIndex(BB);
+    for (auto i = stream.getBlockStart(b); i < stream.getBlockStart(b + 1); i++) {
+      occurrences.emplace_back();
+      auto &[gened, killed] = occurrences.back();
+      auto GEN = stream.getGEN(i), KILL = stream.getKILL(i);
+      for (auto &[id, var] : spilledIDs) {
+        if (std::find(GEN.begin(), GEN.end(), id) != GEN.end())
+          gened.push_back(var);
+        if (std::find(KILL.begin(), KILL.end(), id) != KILL.end())
+          killed.push_back(var);
+      }
+    }
+  }
+
+  void doVisit(const Instruction *I, const std::vector<const Variable *> &gened,
+               const std::vector<const Variable *> &killed) {
     spilledInsts.push_back(I);
-    auto GEN = result->getLivenessSets(I).getGEN(), KILL = result->getLivenessSets(I).getKILL();
-    auto gened = getIntersect(varsToBeSpilled, GEN), killed = getIntersect(varsToBeSpilled, KILL);
 
     // if the variable is not in GEN or KILL, means that it does not appear in this instruction
     if (gened.empty() && killed.empty())
       return;
 
-    for (auto var : varsToBeSpilled)
+    // a fresh temporary is used at each instruction
+    for (auto var : gened)
+      spillInfo->getVarSpillInfo(var)->newVar = nullptr;
+    for (auto var : killed)
       spillInfo->getVarSpillInfo(var)->newVar = nullptr;
 
     spilledInsts.pop_back();
+
+    // the definition of a rematerialized variable is dropped, its uses compute the value again
+    if (killed.size() == 1 && gened.empty() && spillInfo->getVarSpillInfo(killed[0])->remat)
+      return;
+
+    // copies between a variable and its own stack slot, left by live range splitting, vanish
+    if (auto assignInst = dyn_cast<AssignInst>(I))
+      if (gened.size() + killed.size() == 1) {
+        auto var = gened.empty() ? killed[0] : gened[0];
+        auto memLoc = spillInfo->getVarSpillInfo(var)->memLoc;
+        if ((assignInst->getLval() == var && assignInst->getRval() == memLoc) ||
+            (assignInst->getLval() == memLoc && assignInst->getRval() == var))
+          return;
+      }
+
     I->accept(*this);
 
     for (auto var : gened) {
       auto varSpillInfo = spillInfo->getVarSpillInfo(var);
-      spilledInsts.push_back(new AssignInst(varSpillInfo->newVar, varSpillInfo->memLoc));
+      auto value = varSpillInfo->remat ? varSpillInfo->remat : varSpillInfo->memLoc;
+      spilledInsts.push_back(arena->create<AssignInst>(varSpillInfo->newVar, value));
     }
     spilledInsts.push_back(spilledInst);
     for (auto var : killed) {
       auto varSpillInfo = spillInfo->getVarSpillInfo(var);
-      spilledInsts.push_back(new AssignInst(varSpillInfo->memLoc, varSpillInfo->newVar));
+      if (!varSpillInfo->remat)
+        spilledInsts.push_back(
+            arena->create<AssignInst>(varSpillInfo->memLoc, varSpillInfo->newVar));
     }
   }
 
+  void spillBlock(BasicBlock *BB) {
+    spilledInsts.clear();
+    collectOccurrences(BB);
+    auto &instructions = BB->getInstructions();
+    for (size_t i = 0; i < instructions.size(); i++)
+      doVisit(instructions[i], occurrences[i].first, occurrences[i].second);
+    BB->instructions = spilledInsts;
+  }
+
   // setter that should be called for each function
   void loadSpillInfo(SpillInfo *spillInfo, const LivenessResult *result,
                      const std::unordered_set<const Variable *> &varsToBeSpilled, Function *F) {
@@ -223,6 +298,15 @@ public:
     this->spillInfo = spillInfo;
     this->varsToBeSpilled = varsToBeSpilled;
     this->F = F;
+    this->arena = &F->getArena();
+
+    spilledIDs.clear();
+    for (auto var : varsToBeSpilled) {
+      auto id = result->getSymbolTable().findID(var);
+      if (id >= 0)
+        spilledIDs.push_back({id, var});
+    }
+    std::sort(spilledIDs.begin(), spilledIDs.end());
   }
 
 private:
@@ -230,53 +314,77 @@ private:
   const LivenessResult *result;
   SpillInfo *spillInfo;
   std::unordered_set<const Variable *> varsToBeSpilled;
+  std::vector<std::pair<int64_t, const Variable *>> spilledIDs;
   Function *F;
+  Arena *arena;
 
   // BB wise info
   std::vector<const Instruction *> spilledInsts;
+  std::vector<std::pair<std::vector<const Variable *>, std::vector<const Variable *>>> occurrences;
 
   // instruction wise buffer
   const Item *spilledItem;
   const Instruction *spilledInst;
 
-  static Spiller *instance;
-
-  Spiller() = default;
   Spiller(const Spiller &) = delete;
   Spiller &operator=(const Spiller &) = delete;
-
-  friend void spillInBB(BasicBlock *BB);
 };
 
-Spiller *Spiller::instance = nullptr;
-auto spiller = Spiller::getInstance();
-
-void spillInBB(BasicBlock *BB) {
-  spiller->spilledInsts.clear();
-  for (auto I : BB->getInstructions())
-    spiller->doVisit(I);
-  BB->instructions = spiller->spilledInsts;
-}
-
 void spillProgram(Program *P, const LivenessResult &livenessResult) {
   for (auto F : P->getFunctions()) {
     auto spilledF = (FunctionToSpill *)F;
     if (!spilledF->getSpilledVar())
       continue;
-    auto functionSpillInfo = new SpillInfo(spilledF->getSpillPrefix());
+    auto functionSpillInfo = F->getArena().create<SpillInfo>(spilledF->getSpillPrefix(), F);
     auto varsToBeSpilled = std::unordered_set<const Variable *>{spilledF->getSpilledVar()};
-    spiller->loadSpillInfo(functionSpillInfo, &livenessResult, varsToBeSpilled, F);
+    Spiller spiller;
+    spiller.loadSpillInfo(functionSpillInfo, &livenessResult, varsToBeSpilled, F);
     for (auto BB : F->getBasicBlocks())
-      spillInBB(BB);
+      spiller.spillBlock(BB);
     spilledF->setSpilled(true);
   }
 }
 
+/*
+ * Find the variables to be spilled whose only definition assigns a number, a label or a function
+ * name, they can be recomputed at each use.
+ */
+void findRematerializations(const Function *F, SpillInfo &functionSpillInfo,
+                            const LivenessResult &livenessResult,
+                            const std::unordered_set<const Variable *> &varsToBeSpilled) {
+  auto &symbols = livenessResult.getSymbolTable();
+  std::unordered_map<const Variable *, const Item *> values;
+  std::unordered_set<const Variable *> excluded;
+
+  for (auto BB : F->getBasicBlocks())
+    livenessResult.scanBlockGenKill(BB, [&](int64_t i, const IDList &GEN, const IDList &KILL) {
+      for (auto id : KILL) {
+        if (symbols.isRegister(id))
+          continue;
+        auto var = (const Variable *)symbols.getSymbol(id);
+        if (!varsToBeSpilled.count(var))
+          continue;
+
+        auto value = livenessResult.getStream().getConstant(i);
+        if (value == nullptr || values.count(var))
+          excluded.insert(var);
+        else
+          values[var] = value;
+      }
+    });
+
+  for (auto &[var, value] : values)
+    if (!excluded.count(var))
+      functionSpillInfo.setRematerialization(var, value);
+}
+
 void spillFunction(Function *F, SpillInfo &functionSpillInfo, const LivenessResult &livenessResult,
                    const std::unordered_set<const Variable *> &varsToBeSpilled) {
-  spiller->loadSpillInfo(&functionSpillInfo, &livenessResult, varsToBeSpilled, F);
+  findRematerializations(F, functionSpillInfo, livenessResult, varsToBeSpilled);
+  Spiller spiller;
+  spiller.loadSpillInfo(&functionSpillInfo, &livenessResult, varsToBeSpilled, F);
   for (auto BB : F->getBasicBlocks())
-    spillInBB(BB);
+    spiller.spillBlock(BB);
 }
 
 } // namespace L2
\ No newline at end of file
@@ -24,22 +24,52 @@ private:
 struct VarSpillInfo {
   const MemoryLocation *memLoc = nullptr;
   const Variable *newVar = nullptr;
+  // value recomputed before each use instead of loading the variable from a stack slot
+  const Item *remat = nullptr;
 };
 
 class SpillInfo {
 public:
-  SpillInfo(std::string spillPrefix);
+  /*
+   * The stack slots are memory locations of F, the spilled function.
+   */
+  SpillInfo(std::string spillPrefix, Function *F);
   std::string consumeName();
   bool isSpilled(const Variable *var) const;
+  /*
+   * Get the spill info of var, giving it a stack slot if it has none.
+   * The slot is shared with spilled variables var does not conflict with, if the conflicts of
+   * both have been recorded.
+   */
   VarSpillInfo *getVarSpillInfo(const Variable *var);
+
+  /*
+   * Record the variables whose live ranges overlap the one of var.
+   */
+  void setConflicts(const Variable *var, const std::vector<const Variable *> &varConflicts);
+
+  /*
+   * Spill var without a stack slot, its uses are replaced by value.
+   */
+  void setRematerialization(const Variable *var, const Item *value);
   int64_t getSpillCount() const;
   void dump() const;
 
 private:
   std::unordered_map<const Variable *, VarSpillInfo> varSpillInfos;
-  // spillCount means how many variables have been spilled
+  // symmetric conflict lists, only complete for the variables in conflictsKnown
+  std::unordered_map<const Variable *, std::vector<const Variable *>> conflicts;
+  std::unordered_set<const Variable *> conflictsKnown;
+  std::unordered_map<const Variable *, int64_t> slotOf;
+  // a slot can be shared if the conflicts of all its variables are known
+  std::vector<bool> sharable;
+  std::vector<const MemoryLocation *> slotLocations;
+  // spillCount means how many stack slots have been allocated
   int64_t spillCount, nextPostfix;
+
+  int64_t findSlot(const Variable *var);
   std::string spillPrefix;
+  Function *F;
 };
 
 void spillProgram(Program *P, const LivenessResult &livenessResult);
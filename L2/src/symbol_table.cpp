@@ -0,0 +1,39 @@
+#include <L2.h>
+#include <symbol_table.h>
+
+namespace L2 {
+
+// number of GP registers, rsp is never numbered
+const static int64_t registerCount = Register::ID::RSP;
+
+SymbolTable::SymbolTable() {
+  for (int64_t id = 0; id < registerCount; id++) {
+    auto reg = Register::getRegister((Register::ID)id);
+    ids[reg] = id;
+    symbols.push_back(reg);
+  }
+}
+
+int64_t SymbolTable::getID(const Symbol *s) {
+  auto it = ids.find(s);
+  if (it != ids.end())
+    return it->second;
+
+  int64_t id = symbols.size();
+  ids[s] = id;
+  symbols.push_back(s);
+  return id;
+}
+
+int64_t SymbolTable::findID(const Symbol *s) const {
+  auto it = ids.find(s);
+  return it == ids.end() ? -1 : it->second;
+}
+
+const Symbol *SymbolTable::getSymbol(int64_t id) const { return symbols[id]; }
+
+bool SymbolTable::isRegister(int64_t id) const { return id < registerCount; }
+
+int64_t SymbolTable::size() const { return symbols.size(); }
+
+} // namespace L2
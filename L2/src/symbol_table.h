@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <L2.h>
+
+namespace L2 {
+
+/*
+ * Dense numbering of the symbols of a function.
+ * The GP registers always take the IDs equal to their Register::ID, variables are numbered after
+ * them in order of first appearance.
+ */
+class SymbolTable {
+public:
+  SymbolTable();
+
+  /*
+   * Get the ID of a symbol, numbering it if it has not been seen yet.
+   */
+  int64_t getID(const Symbol *s);
+
+  /*
+   * Get the ID of a symbol, or -1 if it has not been numbered.
+   */
+  int64_t findID(const Symbol *s) const;
+  const Symbol *getSymbol(int64_t id) const;
+  bool isRegister(int64_t id) const;
+  int64_t size() const;
+
+private:
+  std::unordered_map<const Symbol *, int64_t> ids;
+  std::vector<const Symbol *> symbols;
+
+  SymbolTable &operator=(const SymbolTable &) = delete;
+  SymbolTable(const SymbolTable &) = delete;
+};
+
+} // namespace L2
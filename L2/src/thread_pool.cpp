@@ -0,0 +1,72 @@
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <thread_pool.h>
+
+namespace L2 {
+
+ThreadPool::ThreadPool(int64_t threadNum) {
+  for (int64_t i = 0; i < threadNum; i++)
+    workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  taskReady.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push(std::move(task));
+    pending++;
+  }
+  taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  allDone.wait(lock, [this] { return pending == 0; });
+  if (error) {
+    auto thrown = error;
+    error = nullptr;
+    std::rethrow_exception(thrown);
+  }
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+
+    std::exception_ptr thrown;
+    try {
+      task();
+    } catch (...) {
+      thrown = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thrown && !error)
+      error = thrown;
+    if (--pending == 0)
+      allDone.notify_all();
+  }
+}
+
+} // namespace L2
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace L2 {
+
+/*
+ * Fixed set of worker threads running the submitted tasks in submission order.
+ */
+class ThreadPool {
+public:
+  ThreadPool(int64_t threadNum);
+  ~ThreadPool();
+
+  void submit(std::function<void()> task);
+
+  /*
+   * Block until every submitted task has finished.
+   * The first exception thrown by a task is thrown again here.
+   */
+  void wait();
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable taskReady, allDone;
+  int64_t pending = 0;
+  bool stopping = false;
+  std::exception_ptr error;
+
+  void work();
+
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool(const ThreadPool &) = delete;
+};
+
+} // namespace L2
@@ -13,6 +13,8 @@ namespace L3 {
 
 const vector<string> argRegs = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
 
+bool nativeCalls = false;
+
 vector<string> generateAssign(string lhs, string rhs) { return {lhs + " <- " + rhs}; }
 
 vector<string> generateCompare(string rst, string lhs, string op, string rhs) {
@@ -64,16 +66,22 @@ vector<string> generateReturnVal(string val) {
 
 vector<string> generateCall(string callee, vector<string> args) {
   vector<string> code;
-  auto labelName = LabelGlobalizer::generateNewName();
-  code.push_back("mem rsp -8 <- " + labelName);
+  string labelName;
+  if (!nativeCalls) {
+    labelName = LabelGlobalizer::generateNewName();
+    code.push_back("mem rsp -8 <- " + labelName);
+  }
   for (int i = 0; i < min(6, (int)args.size()); i++)
     code.push_back(argRegs[i] + " <- " + args[i]);
 
+  // the return label, if any, takes the first slot below rsp
+  auto firstSlot = nativeCalls ? 5 : 4;
   for (int i = 6; i < args.size(); i++)
-    code.push_back("mem rsp -" + to_string(8 * (i - 4)) + " <- " + args[i]);
+    code.push_back("mem rsp -" + to_string(8 * (i - firstSlot)) + " <- " + args[i]);
 
   code.push_back("call " + callee + " " + to_string(args.size()));
-  code.push_back(labelName);
+  if (!nativeCalls)
+    code.push_back(labelName);
   return code;
 }
 
@@ -25,4 +25,11 @@ vector<string> generateLabel(string label);
 
 void generate_code(const TilingResult &result, Program *P);
 
+/*
+ * Calls store a return label at mem rsp -8 and the callee returns to it, unless native calls are
+ * enabled: the return address is then pushed by a call instruction, so that the return is
+ * predicted, and the stack arguments are stored one slot higher.
+ */
+extern bool nativeCalls;
+
 } // namespace L3
@@ -15,7 +15,8 @@ using namespace std;
 #include <parser.h>
 
 void printHelp(char *progName) {
-  cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-s] [-l] [-i] [-d] SOURCE" << endl;
+  cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-n] [-s] [-l] [-i] [-d] SOURCE"
+       << endl;
   return;
 }
 
@@ -33,12 +34,16 @@ int main(int argc, char **argv) {
   }
   int32_t opt;
   int64_t functionNumber = -1;
-  while ((opt = getopt(argc, argv, "vg:O:d")) != -1) {
+  while ((opt = getopt(argc, argv, "vg:O:nd")) != -1) {
     switch (opt) {
     case 'O':
       optLevel = strtoul(optarg, NULL, 0);
       break;
 
+    case 'n':
+      L3::nativeCalls = true;
+      break;
+
     case 'g':
       enableCodeGenerator = (strtoul(optarg, NULL, 0) == 0) ? false : true;
       break;